@@ -8,7 +8,7 @@
 
 #include "Perspective.hpp"
 
-bool Perspective::GenerateRay(const int x, const int y, Ray *r, const float *cam_jitter) {
+bool Perspective::GenerateRay(const int x, const int y, Ray *r, Sampler &sampler, const float *cam_jitter) {
     Point pc;
     
     if (cam_jitter==NULL) {
@@ -23,16 +23,18 @@ bool Perspective::GenerateRay(const int x, const int y, Ray *r, const float *cam
     Point pixel_sample = pixel00_loc + (pc.X * pixel_delta_u) + (pc.Y * pixel_delta_v);
     r->o = Eye;
     if (defocus_angle > 0.f) {
-        Point p = random_in_unit_disk();
+        Point p = random_in_unit_disk(sampler);
         r->o = Eye + p.X * defocus_disk_R + p.Y*defocus_disk_Up;
     } else {
         r->o = Eye;
     }
     r->dir = r->o.vec2point(pixel_sample);
     r->dir.normalize();
+    r->invertDir();
 
     r->pix_x = x;
     r->pix_y = y;
+    r->coneSpread = pixelSpread;
     
     r->FaceID = -1;
     r->propagating_eta = 1.f;
@@ -12,7 +12,6 @@
 #include "camera.hpp"
 #include "ray.hpp"
 #include "vector.hpp"
-#include <random>
 
 class Perspective: public Camera {
 private:
@@ -21,17 +20,14 @@ private:
     Vector defocus_disk_Up, defocus_disk_R;
     int W, H;
     float defocus_angle;
+    float pixelSpread;    // angle subtended by a pixel (see Ray::coneSpread)
 
-    /****************************************
-     
-     Our Random Number Generator (rng) */
-    std::random_device rdev{};
-    std::mt19937 rng{rdev()};
-    std::uniform_real_distribution<float>U_dist{-1.0,1.0};  // uniform distribution in[0,1[
-    
-    inline Point random_in_unit_disk() {
+    inline Point random_in_unit_disk(Sampler &sampler) {
         while (true) {
-            Point p(U_dist(rng), U_dist(rng), 0.);
+            // uniform in [-1,1[
+            const float px = 2.f * sampler.Get1D() - 1.f;
+            const float py = 2.f * sampler.Get1D() - 1.f;
+            Point p(px, py, 0.);
             if ((p.X*p.X + p.Y*p.Y) < 1.)
                 return p;
         }
@@ -57,6 +53,7 @@ public:
         // Determine viewport dimensions.
         // precompute the tangents
         tan_halfH = tanf(_fovH/2.f);
+        pixelSpread = 2.f * tan_halfH / H;
         float viewport_height = 2.0 * tan_halfH * _focus_dist;
         //float viewport_height = 2.0 * focal_length;
         float viewport_width = viewport_height * W/H;
@@ -80,7 +77,7 @@ public:
         defocus_disk_Up = Up * defocus_radius;
     }
 
-    bool GenerateRay(const int x, const int y, Ray *r, const float *cam_jitter=NULL);
+    bool GenerateRay(const int x, const int y, Ray *r, Sampler &sampler, const float *cam_jitter=NULL);
     void getResolution (int *_W, int *_H) {*_W=W; *_H=H;}
 };
 
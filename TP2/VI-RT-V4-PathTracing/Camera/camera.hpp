@@ -9,13 +9,15 @@
 #define camera_hpp
 
 #include "ray.hpp"
+#include "Sampler.hpp"
 
 // based on pbrt book, sec 6.1, pag. 356
 class Camera {
 public:
     Camera () {}
     ~Camera() {}
-    virtual bool GenerateRay(const int x, const int y, Ray *r, const float *cam_jitter=NULL) {return false;};
+    // sampler provides the random numbers (e.g., lens sampling) for this pixel sample
+    virtual bool GenerateRay(const int x, const int y, Ray *r, Sampler &sampler, const float *cam_jitter=NULL) {return false;};
     virtual void getResolution (int *_W, int *_H) {*_W=0; *_H=0;}
 };
 
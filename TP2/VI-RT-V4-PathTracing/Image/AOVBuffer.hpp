@@ -0,0 +1,65 @@
+//
+//  AOVBuffer.hpp
+//  VI-RT-V4-PathTracing
+//
+//  auxiliary buffers (arbitrary output variables) of a frame: the features
+//  of the first surface hit by the primary rays, averaged over the samples
+//  of each pixel (see StandardRenderer::aov) ; they guide the denoiser (see ATrous)
+//
+
+#ifndef AOVBuffer_hpp
+#define AOVBuffer_hpp
+
+#include "RGB.hpp"
+#include "vector.hpp"
+#include <vector>
+
+class AOVBuffer {
+public:
+    int W, H;
+    // light sources are recorded as if no surface was hit
+    std::vector<RGB> albedo;      // reflectance ; 1 where no surface is hit
+    std::vector<Vector> normal;   // unit shading normal, facing the camera ; 0 where no surface is hit
+    std::vector<float> depth;     // distance to the camera ; 0 where no surface is hit
+
+    // while rendering the features are summed over the samples of each pixel:
+    // the number of samples that hit a surface ; -1 once one hits a light source
+    std::vector<int> hits;
+
+    AOVBuffer (): W(0), H(0) {}
+    // sets the size and clears the sums
+    void reset (const int _W, const int _H) {
+        W = _W;
+        H = _H;
+        albedo.assign(W*H, RGB(0., 0., 0.));
+        normal.assign(W*H, Vector(0., 0., 0.));
+        depth.assign(W*H, 0.f);
+        hits.assign(W*H, 0);
+    }
+    // the sums over spp samples per pixel -> the averages
+    void resolve (const int spp) {
+        #pragma omp parallel for schedule(static)
+        for (int i=0 ; i<W*H ; i++) {
+            // the emitted radiance is not comparable to the reflected one:
+            // the pixels covering light sources, even partially, are
+            // recorded as if no surface was hit (not filtered) ; as are
+            // those whose normals cancel out (e.g., both sides of a thin
+            // object), which would otherwise be NaN
+            const float len = normal[i].norm();
+            if (hits[i] < 0 || (hits[i] > 0 && !(len > 0.f))) {
+                albedo[i] = RGB(1., 1., 1.);
+                normal[i] = Vector(0., 0., 0.);
+                depth[i] = 0.f;
+                continue;
+            }
+            albedo[i] = albedo[i] / (float)spp;
+            if (hits[i] > 0) {
+                normal[i] = normal[i] / len;
+                depth[i] = depth[i] / hits[i];
+            }
+        }
+    }
+    bool hit (const int i) const { return depth[i] > 0.f; }
+};
+
+#endif /* AOVBuffer_hpp */
@@ -0,0 +1,88 @@
+//
+//  ImageCache.cpp
+//  VI-RT-V4-PathTracing
+//
+
+#include "ImageCache.hpp"
+#include <map>
+#include <mutex>
+#include <sys/stat.h>
+
+bool ImageCache::useSidecars = false;
+
+template <class T>
+struct CacheEntry {
+    time_t mtime;
+    std::shared_ptr<const T> image;
+};
+
+// the scenes may be built by several threads (see FramePipeline)
+// recursive: a texture is built from the cached PPM
+static std::recursive_mutex cacheMutex;
+static std::map<std::string, CacheEntry<ImagePPM> > ppmCache;
+static std::map<std::string, CacheEntry<ImageHDR> > hdrCache;
+static std::map<std::string, CacheEntry<MipMap> > textureCache;
+
+// -1 if the file does not exist
+static time_t ModificationTime (const std::string &filename) {
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0) return -1;
+    return st.st_mtime;
+}
+
+// the cached image if the file was not modified since it was read ;
+// otherwise it is read by load(image, mtime) and cached if that succeeds
+// the image is read with the cache locked, such that it is read only once
+// if requested by several threads
+template <class T, class LoadFn>
+static std::shared_ptr<const T> Get (std::map<std::string, CacheEntry<T> > &cache, const std::string &filename, LoadFn load) {
+    const time_t mtime = ModificationTime(filename);
+    std::lock_guard<std::recursive_mutex> lock(cacheMutex);
+
+    auto it = cache.find(filename);
+    if (it != cache.end() && it->second.mtime == mtime) return it->second.image;
+
+    std::shared_ptr<T> image = std::make_shared<T>();
+    if (!load(*image, mtime)) return image;
+    CacheEntry<T> &entry = cache[filename];
+    entry.mtime = mtime;
+    entry.image = image;
+    return image;
+}
+
+std::shared_ptr<const ImagePPM> ImageCache::PPM (const std::string &filename) {
+    return Get(ppmCache, filename, [&](ImagePPM &image, const time_t mtime) {
+        return image.Load(filename);
+    });
+}
+
+std::shared_ptr<const ImageHDR> ImageCache::HDR (const std::string &filename) {
+    return Get(hdrCache, filename, [&](ImageHDR &image, const time_t mtime) {
+        const std::string sidecar = filename + ".rgbf";
+        if (useSidecars && image.LoadSidecar(sidecar, mtime)) return true;
+        if (!image.Load(filename)) return false;
+        if (useSidecars) image.SaveSidecar(sidecar, mtime);
+        return true;
+    });
+}
+
+std::shared_ptr<const MipMap> ImageCache::Texture (const std::string &filename) {
+    return Get(textureCache, filename, [&](MipMap &texture, const time_t mtime) {
+        return texture.Build(*PPM(filename));
+    });
+}
+
+template <class T>
+static void DropUnused (std::map<std::string, CacheEntry<T> > &cache) {
+    for (auto it = cache.begin(); it != cache.end(); ) {
+        if (it->second.image.use_count() == 1) it = cache.erase(it);
+        else ++it;
+    }
+}
+
+void ImageCache::Clear (void) {
+    std::lock_guard<std::recursive_mutex> lock(cacheMutex);
+    DropUnused(textureCache);
+    DropUnused(ppmCache);
+    DropUnused(hdrCache);
+}
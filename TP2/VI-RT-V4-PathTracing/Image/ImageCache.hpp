@@ -0,0 +1,41 @@
+//
+//  ImageCache.hpp
+//  VI-RT-V4-PathTracing
+//
+//  process wide cache of the images read from files (textures and HDR probes)
+//  and of the texture pyramids built from them
+//  each file is decoded once and the same immutable image is shared by all
+//  the materials and lights that use it, across frames and scenes
+//  an entry is keyed by the file's path and modification time: a file
+//  modified since it was read is read again
+//
+//  optionally (useSidecars), a decoded HDR probe is also written next to its
+//  file as a binary sidecar (<file>.rgbf, see ImageHDR::SaveSidecar()) which
+//  later runs map into memory instead of decoding the probe
+//
+
+#ifndef ImageCache_hpp
+#define ImageCache_hpp
+
+#include "ImagePPM.hpp"
+#include "ImageHDR.hpp"
+#include "MipMap.hpp"
+#include <memory>
+#include <string>
+
+class ImageCache {
+public:
+    static bool useSidecars;
+
+    // the image read from filename ; an empty image (W = H = 0) if the file
+    // can't be read, which is not cached
+    static std::shared_ptr<const ImagePPM> PPM (const std::string &filename);
+    static std::shared_ptr<const ImageHDR> HDR (const std::string &filename);
+    // the pyramid of PPM(filename), built once ; empty (no levels) if the file can't be read
+    static std::shared_ptr<const MipMap> Texture (const std::string &filename);
+
+    // drops the images not referenced outside the cache
+    static void Clear (void);
+};
+
+#endif /* ImageCache_hpp */
@@ -3,18 +3,37 @@
 #include <string>
 #include <cmath>
 #include <algorithm> 
+#include <vector>
+#include <cstdio>
+#include <stdint.h>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_STATIC
 #include "stb_image.h"
 
-ImageHDR::ImageHDR(const std::string& filename) {
+ImageHDR::ImageHDR(const std::string& filename): mapped(NULL), mappedSize(0), octN(0) {
     Load(filename);
 }
 
 ImageHDR::~ImageHDR() {
+#if defined(__unix__) || defined(__APPLE__)
+    if (mapped) {
+        munmap(mapped, mappedSize);
+        imagePlane = NULL;
+    }
+#endif
     if (imagePlane) {
         delete[] imagePlane;
+        imagePlane = NULL;   // ~Image() deletes it otherwise
     }
 }
 
@@ -40,9 +59,151 @@ bool ImageHDR::Load(const std::string& filename) {
     }
 
     stbi_image_free(data);
+    BuildDistribution();
+    BuildOctahedral();
+    return true;
+}
+
+typedef struct {
+    char magic[8];
+    int32_t W, H;
+    int64_t sourceTime;
+} SidecarHeader;
+
+static const char sidecarMagic[8] = {'V', 'I', 'R', 'T', 'R', 'G', 'B', 'F'};
+
+// written to a temporary file first, such that a sidecar is never read incomplete
+bool ImageHDR::SaveSidecar(const std::string& sidecar, time_t sourceTime) const {
+    if (W == 0 || H == 0) return false;
+    SidecarHeader header;
+    memcpy(header.magic, sidecarMagic, sizeof(sidecarMagic));
+    header.W = W;
+    header.H = H;
+    header.sourceTime = sourceTime;
+
+    const std::string tmp = sidecar + ".tmp";
+    FILE *fp = fopen(tmp.c_str(), "wb");
+    if (!fp) return false;
+    bool ok = (fwrite(&header, sizeof(header), 1, fp) == 1);
+    ok = ok && (fwrite(imagePlane, sizeof(RGB), W * H, fp) == (size_t)(W * H));
+    ok = (fclose(fp) == 0) && ok;
+    if (ok) ok = (rename(tmp.c_str(), sidecar.c_str()) == 0);
+    if (!ok) remove(tmp.c_str());
+    return ok;
+}
+
+bool ImageHDR::LoadSidecar(const std::string& sidecar, time_t sourceTime) {
+#if defined(__unix__) || defined(__APPLE__)
+    const int fd = open(sidecar.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SidecarHeader)) {
+        close(fd);
+        return false;
+    }
+    const size_t size = st.st_size;
+    void *base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return false;
+
+    const SidecarHeader *header = (const SidecarHeader *)base;
+    if (memcmp(header->magic, sidecarMagic, sizeof(sidecarMagic)) != 0 ||
+        header->sourceTime != sourceTime || header->W <= 0 || header->H <= 0 ||
+        size != sizeof(SidecarHeader) + (size_t)header->W * header->H * sizeof(RGB)) {
+        munmap(base, size);
+        return false;
+    }
+    W = header->W;
+    H = header->H;
+    // read only: the image is not modified once loaded
+    imagePlane = (RGB *)((char *)base + sizeof(SidecarHeader));
+    mapped = base;
+    mappedSize = size;
+    BuildDistribution();
+    BuildOctahedral();
+    return true;
+#else
+    return false;
+#endif
+}
+
+/*
+The probe maps the direction at angle theta from +z to the circle of radius
+rho = theta/(2*pi) around (0.5,0.5) (see SampleDirection() below), hence
+theta = 2*pi*rho and a small area dA of the image covers the solid angle
+dw = sin(theta) dtheta dphi = (4*pi^2 * sin(theta)/theta) dA.
+Pixels are weighted by their luminance times this factor so that sampling
+the image is roughly proportional to the radiance per unit solid angle.
+*/
+
+// builds the 2D CDF over the probe
+// pbrt 3rd edition, sec 14.2.4 (infinite area lights)
+void ImageHDR::BuildDistribution(void) {
+    std::vector<float> f(W * H, 0.f);
+
+    for (int y = 0; y < H; ++y) {
+        for (int x = 0; x < W; ++x) {
+            const float u = (x + 0.5f) / W - 0.5f;
+            const float v = (y + 0.5f) / H - 0.5f;
+            const float rho = std::sqrt(u * u + v * v);
+            // pixels entirely outside the circle never map to a direction
+            const float halfDiag = 0.5f * std::sqrt(1.f / (W * W) + 1.f / (H * H));
+            if (rho - halfDiag > 0.5f) continue;
+
+            // SampleDirection() interpolates neighbouring pixels, so use the
+            // largest luminance around (x,y): no radiance is left with pdf 0
+            float Y = 0.f;
+            for (int j = std::max(y - 1, 0); j <= std::min(y + 1, H - 1); ++j)
+                for (int i = std::max(x - 1, 0); i <= std::min(x + 1, W - 1); ++i)
+                    Y = std::max(Y, imagePlane[j * W + i].Y());
+
+            // sin(theta)/theta, kept positive at the border of the circle
+            const float theta = std::min(std::max(2.f * (float)M_PI * rho, 1e-4f), 0.999f * (float)M_PI);
+            f[y * W + x] = Y * std::sin(theta) / theta;
+        }
+    }
+    distribution.Build(f.data(), W, H);
+}
+
+bool ImageHDR::SampleImportance(const float u[2], Vector* dir, float* pdf) const {
+    *pdf = 0.f;
+    if (distribution.IsEmpty()) return false;
+
+    float uv[2], pdf_uv;
+    distribution.SampleContinuous(u, uv, &pdf_uv);
+    if (pdf_uv == 0.f) return false;
+
+    // inverse of the mapping in SampleDirection()
+    const float uc = uv[0] - 0.5f, vc = uv[1] - 0.5f;
+    const float rho = std::sqrt(uc * uc + vc * vc);
+    if (rho > 0.5f) return false;   // corner of the image: not a direction
+    const float theta = 2.f * (float)M_PI * rho;
+    const float sinTheta = std::sin(theta);
+    if (rho > 1e-6f) {
+        *dir = Vector(sinTheta * uc / rho, sinTheta * vc / rho, std::cos(theta));
+    } else {
+        *dir = Vector(0.f, 0.f, 1.f);
+    }
+    if (sinTheta <= 0.f) return false;
+
+    *pdf = pdf_uv * theta / (4.f * (float)(M_PI * M_PI) * sinTheta);
     return true;
 }
 
+float ImageHDR::Pdf(const Vector& dir) const {
+    if (distribution.IsEmpty()) return 0.f;
+    Vector D = dir;
+    D.normalize();
+
+    const float theta = std::acos(std::min(std::max(D.Z, -1.f), 1.f));
+    const float sinTheta = std::sin(theta);
+    if (sinTheta <= 0.f) return 0.f;
+    const float r = (1.0f / (2.0f * M_PI)) * theta / std::sqrt(D.X * D.X + D.Y * D.Y);
+
+    const float pdf_uv = distribution.Pdf(0.5f + D.X * r, 0.5f + D.Y * r);
+    return pdf_uv * theta / (4.f * (float)(M_PI * M_PI) * sinTheta);
+}
+
 
 /*
 Thus, if we consider the images to be normalized to have coordinates u=[-1,1], v=[-1,1], we have theta=atan2(v,u), phi=pi*sqrt(u*u+v*v). 
@@ -52,7 +213,7 @@ The unit vector pointing in the corresponding direction is obtained by rotating
 If for a direction vector in the world (Dx, Dy, Dz), the corresponding (u,v) coordinate in the light probe image is (Dx*r,Dy*r) where r=(1/pi)*acos(Dz)/sqrt(Dx^2 + Dy^2).
 */
 
-RGB ImageHDR::SampleDirection(const Vector& dir) const {
+RGB ImageHDR::SampleAngular(const Vector& dir) const {
     Vector D = dir;
     D.normalize();
 
@@ -107,3 +268,138 @@ RGB ImageHDR::SampleDirection(const Vector& dir) const {
 
     return c;
 }
+
+/*
+The octahedral map projects a direction d on the octahedron |x|+|y|+|z| = 1
+and unfolds it on the square [-1,1]^2: the upper hemisphere (z >= 0) maps to
+the inner diamond |x|+|y| <= 1, the lower one is folded over its edges to the
+corners of the square. Crossing an edge of the square is thus the same as
+crossing back at the mirrored position on that edge, which the border texels
+replicate.
+*/
+
+static inline float SignNotZero(const float v) {
+    return (v < 0.f ? -1.f : 1.f);
+}
+
+// the probe is evaluated at the centre of each texel of a map with as many
+// texels across as the probe
+void ImageHDR::BuildOctahedral(void) {
+    octN = W;
+    const int N = octN, S = N + 2;
+    oct.assign(4 * S * S, 0.f);
+
+    #pragma omp parallel for schedule(dynamic, 16)
+    for (int j = 0; j < N; ++j) {
+        for (int i = 0; i < N; ++i) {
+            float px = 2.f * (i + 0.5f) / N - 1.f;
+            float py = 2.f * (j + 0.5f) / N - 1.f;
+            const float pz = 1.f - std::fabs(px) - std::fabs(py);
+            if (pz < 0.f) {
+                const float fx = (1.f - std::fabs(py)) * SignNotZero(px);
+                const float fy = (1.f - std::fabs(px)) * SignNotZero(py);
+                px = fx;
+                py = fy;
+            }
+            const RGB c = SampleAngular(Vector(px, py, pz));
+            float *t = &oct[4 * ((j + 1) * S + i + 1)];
+            t[0] = c.R;
+            t[1] = c.G;
+            t[2] = c.B;
+        }
+    }
+    // border: mirrored across the edge it lies on (twice for the corners)
+    for (int j = -1; j <= N; ++j) {
+        for (int i = -1; i <= N; ++i) {
+            if (i >= 0 && i < N && j >= 0 && j < N) continue;
+            int si = i, sj = j;
+            if (si < 0)  { si = 0;     sj = N - 1 - sj; }
+            if (si >= N) { si = N - 1; sj = N - 1 - sj; }
+            if (sj < 0)  { sj = 0;     si = N - 1 - si; }
+            if (sj >= N) { sj = N - 1; si = N - 1 - si; }
+            memcpy(&oct[4 * ((j + 1) * S + i + 1)], &oct[4 * ((sj + 1) * S + si + 1)], 4 * sizeof(float));
+        }
+    }
+}
+
+// bilinear interpolation at (fx,fy), in texels of the map with its border,
+// clamped to [0, octN]
+RGB ImageHDR::FetchOctahedral(float fx, float fy) const {
+    const int S = octN + 2;
+    const int x0 = (int)fx, y0 = (int)fy;
+    const float dx = fx - x0, dy = fy - y0;
+    const float *t = &oct[4 * (y0 * S + x0)];
+#ifdef __SSE__
+    const __m128 c00 = _mm_loadu_ps(t), c10 = _mm_loadu_ps(t + 4);
+    const __m128 c01 = _mm_loadu_ps(t + 4 * S), c11 = _mm_loadu_ps(t + 4 * S + 4);
+    const __m128 wx = _mm_set1_ps(dx), wy = _mm_set1_ps(dy);
+    const __m128 c0 = _mm_add_ps(c00, _mm_mul_ps(_mm_sub_ps(c10, c00), wx));
+    const __m128 c1 = _mm_add_ps(c01, _mm_mul_ps(_mm_sub_ps(c11, c01), wx));
+    float c[4];
+    _mm_storeu_ps(c, _mm_add_ps(c0, _mm_mul_ps(_mm_sub_ps(c1, c0), wy)));
+#else
+    float c[3];
+    for (int k = 0; k < 3; ++k) {
+        const float c0 = t[k] + (t[4 + k] - t[k]) * dx;
+        const float c1 = t[4 * S + k] + (t[4 * S + 4 + k] - t[4 * S + k]) * dx;
+        c[k] = c0 + (c1 - c0) * dy;
+    }
+#endif
+    return RGB(c[0], c[1], c[2]);
+}
+
+RGB ImageHDR::SampleDirection(const Vector& dir) const {
+    if (octN == 0) return RGB(0.f, 0.f, 0.f);
+    const float l1 = std::fabs(dir.X) + std::fabs(dir.Y) + std::fabs(dir.Z);
+    if (l1 <= 0.f) return RGB(0.f, 0.f, 0.f);
+    const float inv = 1.f / l1;
+    float px = dir.X * inv, py = dir.Y * inv;
+    if (dir.Z < 0.f) {
+        const float fx = (1.f - std::fabs(py)) * SignNotZero(px);
+        const float fy = (1.f - std::fabs(px)) * SignNotZero(py);
+        px = fx;
+        py = fy;
+    }
+    // [-1,1] to texels, the border included
+    const float scale = 0.5f * octN, offset = 0.5f * octN + 0.5f;
+    const float fx = std::min(std::max(px * scale + offset, 0.f), (float)octN);
+    const float fy = std::min(std::max(py * scale + offset, 0.f), (float)octN);
+    return FetchOctahedral(fx, fy);
+}
+
+// the directions are mapped to the octahedron 4 at a time
+void ImageHDR::SampleDirections(const int n, const Vector* dirs, RGB* L) const {
+    if (octN == 0) {
+        for (int k = 0; k < n; ++k) L[k] = RGB(0.f, 0.f, 0.f);
+        return;
+    }
+    int k = 0;
+#ifdef __SSE__
+    const __m128 signMask = _mm_set1_ps(-0.f), one = _mm_set1_ps(1.f), zero = _mm_setzero_ps();
+    const __m128 scale = _mm_set1_ps(0.5f * octN), offset = _mm_set1_ps(0.5f * octN + 0.5f);
+    const __m128 maxF = _mm_set1_ps((float)octN);
+    for (; k + 4 <= n; k += 4) {
+        const Vector *d = &dirs[k];
+        const __m128 x = _mm_set_ps(d[3].X, d[2].X, d[1].X, d[0].X);
+        const __m128 y = _mm_set_ps(d[3].Y, d[2].Y, d[1].Y, d[0].Y);
+        const __m128 z = _mm_set_ps(d[3].Z, d[2].Z, d[1].Z, d[0].Z);
+        const __m128 ax = _mm_andnot_ps(signMask, x), ay = _mm_andnot_ps(signMask, y);
+        const __m128 az = _mm_andnot_ps(signMask, z);
+        const __m128 inv = _mm_div_ps(one, _mm_add_ps(_mm_add_ps(ax, ay), az));
+        __m128 px = _mm_mul_ps(x, inv), py = _mm_mul_ps(y, inv);
+        // lower hemisphere: folded over the edges of the diamond
+        const __m128 lower = _mm_cmplt_ps(z, zero);
+        const __m128 apx = _mm_andnot_ps(signMask, px), apy = _mm_andnot_ps(signMask, py);
+        const __m128 fx = _mm_or_ps(_mm_sub_ps(one, apy), _mm_and_ps(px, signMask));
+        const __m128 fy = _mm_or_ps(_mm_sub_ps(one, apx), _mm_and_ps(py, signMask));
+        px = _mm_or_ps(_mm_and_ps(lower, fx), _mm_andnot_ps(lower, px));
+        py = _mm_or_ps(_mm_and_ps(lower, fy), _mm_andnot_ps(lower, py));
+        // (a NaN, for a null direction, is clamped to 0)
+        float tx[4], ty[4];
+        _mm_storeu_ps(tx, _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(px, scale), offset), zero), maxF));
+        _mm_storeu_ps(ty, _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(py, scale), offset), zero), maxF));
+        for (int l = 0; l < 4; ++l) L[k + l] = FetchOctahedral(tx[l], ty[l]);
+    }
+#endif
+    for (; k < n; ++k) L[k] = SampleDirection(dirs[k]);
+}
@@ -2,18 +2,63 @@
 #define ImageHDR_hpp
 #include "image.hpp"
 #include "vector.hpp"
+#include "Distribution.hpp"
+#include <ctime>
+#include <cstddef>
+#include <vector>
 
 
 class ImageHDR : public Image {
+    // luminance of the probe weighted by the solid angle of each pixel
+    // used to importance sample directions (built by Load())
+    Distribution2D distribution;
+    void BuildDistribution(void);
+    // the pixels of a sidecar mapped in memory (see LoadSidecar()), NULL otherwise
+    void *mapped;
+    size_t mappedSize;
+    // the probe resampled on an octahedral map (built by Load()), such that
+    // a direction is mapped to a texel without trigonometry:
+    // (octN+2)^2 RGBA texels, with a border of 1 texel replicating the texels
+    // across the edges, for the bilinear interpolation
+    // Engelhardt and Dachsbacher, "Octahedron Environment Maps", VMV 2008
+    int octN;
+    std::vector<float> oct;
+    void BuildOctahedral(void);
+    RGB FetchOctahedral(float fx, float fy) const;
 public:
-    ImageHDR(): Image() {}
+    ImageHDR(): Image(), mapped(NULL), mappedSize(0), octN(0) {}
     ImageHDR(const std::string& filename);
     ~ImageHDR();
 
     bool Load(const std::string& filename);
 
+    // the decoded pixels, stored as a binary file (a header followed by the
+    // RGB floats) which is mapped in memory instead of being decoded again
+    // sourceTime is the modification time of the file the pixels were read
+    // from: a sidecar written for another version of that file is rejected
+    bool SaveSidecar(const std::string& sidecar, time_t sourceTime) const;
+    bool LoadSidecar(const std::string& sidecar, time_t sourceTime);
+
     // Sample a direction on the unit sphere and return the color from imagePlane
+    // (bilinear interpolation on the light probe)
+    RGB SampleAngular(const Vector& dir) const;
+
+    // the same radiance, looked up on the octahedral map: dir needs not be
+    // normalized ; resampling the probe adds one bilinear interpolation, the
+    // differences to SampleAngular() being within the variation between
+    // neighbouring pixels: over uniform directions, the mean absolute difference
+    // is 1.4% (rnl_probe.hdr) and 0.13% (beach_probe.hdr) of the mean
+    // luminance, the largest ones at the sharp edges of the light sources
     RGB SampleDirection(const Vector& dir) const;
+    // SampleDirection() for n directions at once
+    void SampleDirections(const int n, const Vector* dirs, RGB* L) const;
+
+    // Sample a direction with probability roughly proportional to its radiance
+    // given u uniform in [0,1[^2 ; returns false (pdf = 0) if the sample is wasted
+    bool SampleImportance(const float u[2], Vector* dir, float* pdf) const;
+
+    // solid angle density of SampleImportance() returning direction dir
+    float Pdf(const Vector& dir) const;
 };
 
 #endif // ImageHDR_hpp
\ No newline at end of file
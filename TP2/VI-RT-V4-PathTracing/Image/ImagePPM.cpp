@@ -9,31 +9,8 @@
 #include <iostream>
 #include <fstream>
 
-#include "Reinhard.hpp"
-#include "Box.hpp"
-#include "Median.hpp"
-
 void ImagePPM::ImgClamp (int const W, int const H, RGB *image, char_pixel *img2save) {
-    
-    // Use a Post Filter ?
-    //Box F;
-    Median F;
-    RGB * imageTM = new RGB[W*H];
-    //F.Filter(W, H, image, imageTM);
-    // Use a Tone Mapper ?
-    Reinhard TM;
-    TM.ToneMap(W, H, image, imageTM);
-    
-    // loop over each pixel in the image, clamp and convert to byte format
-    for (int j = 0 ; j< H ; j++) {
-        for (int i = 0; i < W ; ++i) {
-            RGB Cout = imageTM[j*W+i];
-            img2save[j*W+i].val[0] = (unsigned char)(fmax(fmin(1.f, Cout.R),0.f) * 255);
-            img2save[j*W+i].val[1] = (unsigned char)(fmax(fmin(1.f, Cout.G),0.f) * 255);
-            img2save[j*W+i].val[2] = (unsigned char)(fmax(fmin(1.f, Cout.B),0.f) * 255);
-        }
-    }
-    delete [] imageTM;
+    post.Run(W, H, image, img2save);
 }
 
 
@@ -44,22 +21,15 @@ bool ImagePPM::Save (std::string filename) {
     if (W == 0 || H == 0) { fprintf(stderr, "Can't save an empty image\n"); return false; }
     
     // convert from float to {0,1,..., 255}
-    imageToSave = new char_pixel[W*H];
-
-    ImgClamp(W, H, imagePlane, imageToSave);
+    imageToSave.resize(W*H);
+    ImgClamp(W, H, imagePlane, imageToSave.data());
     std::ofstream ofs;
     try {
         ofs.open(filename, std::ios::binary);  //need to spec. binary mode for Windows users
         if (ofs.fail()) throw("Can't open output file");
         ofs << "P6\n" << W << " " << H << "\n255\n";
-        unsigned char r, g, b;
-        // loop over each pixel in the image, clamp and convert to byte format
-        for (int i = 0; i < W * H; ++i) {
-            r = imageToSave[i].val[0];
-            g = imageToSave[i].val[1];
-            b = imageToSave[i].val[2];
-            ofs << r << g << b;
-        }
+        // the pixels are 3 contiguous bytes each
+        ofs.write(reinterpret_cast<const char *>(imageToSave.data()), W * H * sizeof(char_pixel));
         ofs.close();
         return true;
     }
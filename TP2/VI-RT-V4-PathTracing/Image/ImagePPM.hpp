@@ -8,13 +8,14 @@
 #ifndef ImagePPM_hpp
 #define ImagePPM_hpp
 #include "image.hpp"
-//#include "ToneMap.hpp"
-//#include "Reinhard.hpp"
+#include "PostProcess.hpp"
+#include <vector>
 
 class ImagePPM: public Image {
-    char_pixel *imageToSave;
+    std::vector<char_pixel> imageToSave;   // reused across Save()s
 
 public:
+    PostProcess post;   // applied by Save()
     ImagePPM(const int W, const int H):Image(W, H) {}
     ImagePPM():Image() {}
     bool Save (std::string filename);
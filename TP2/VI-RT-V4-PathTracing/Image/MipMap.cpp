@@ -0,0 +1,109 @@
+//
+//  MipMap.cpp
+//  VI-RT-V4-PathTracing
+//
+
+#include "MipMap.hpp"
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+
+static inline unsigned char Quantize (const float v) {
+    return (unsigned char)(std::min(std::max(v, 0.f), 1.f) * 255.f + 0.5f);
+}
+
+// each level is box filtered from the previous one (in floating point, such
+// that the 8 bit rounding does not accumulate) ; odd sizes are rounded up,
+// the last row / column being repeated
+bool MipMap::Build (const Image &img) {
+    levels.clear();
+    storage.clear();
+    texels = NULL;
+    if (img.W <= 0 || img.H <= 0) return false;
+
+    std::vector<std::vector<RGB> > pyramid(1, std::vector<RGB>(img.W * img.H));
+    for (int y = 0; y < img.H; y++) {
+        for (int x = 0; x < img.W; x++) {
+            pyramid[0][y * img.W + x] = img.get(x, y);
+        }
+    }
+    int W = img.W, H = img.H;
+    int nTiles = 0;
+    while (true) {
+        Level l;
+        l.W = W;
+        l.H = H;
+        l.tilesX = (W + tileSize - 1) / tileSize;
+        l.tileOffset = nTiles;
+        nTiles += l.tilesX * ((H + tileSize - 1) / tileSize);
+        levels.push_back(l);
+        if (W == 1 && H == 1) break;
+
+        const int nW = (W + 1) / 2, nH = (H + 1) / 2;
+        const std::vector<RGB> &fine = pyramid.back();
+        std::vector<RGB> coarse(nW * nH);
+        for (int y = 0; y < nH; y++) {
+            const int y0 = 2 * y, y1 = std::min(2 * y + 1, H - 1);
+            for (int x = 0; x < nW; x++) {
+                const int x0 = 2 * x, x1 = std::min(2 * x + 1, W - 1);
+                RGB sum = fine[y0 * W + x0];
+                sum += fine[y0 * W + x1];
+                sum += fine[y1 * W + x0];
+                sum += fine[y1 * W + x1];
+                coarse[y * nW + x] = sum * 0.25f;
+            }
+        }
+        pyramid.push_back(coarse);
+        W = nW;
+        H = nH;
+    }
+
+    const int tileBytes = tileSize * tileSize * sizeof(Texel);
+    storage.assign(nTiles * tileBytes + 63, 0);
+    texels = (Texel *)(((uintptr_t)storage.data() + 63) & ~(uintptr_t)63);
+    for (size_t i = 0; i < levels.size(); i++) {
+        const Level &l = levels[i];
+        for (int y = 0; y < l.H; y++) {
+            for (int x = 0; x < l.W; x++) {
+                const RGB &c = pyramid[i][y * l.W + x];
+                const int tile = l.tileOffset + (y / tileSize) * l.tilesX + (x / tileSize);
+                Texel &t = texels[tile * tileSize * tileSize + (y % tileSize) * tileSize + (x % tileSize)];
+                t.r = Quantize(c.R);
+                t.g = Quantize(c.G);
+                t.b = Quantize(c.B);
+                t.a = 255;
+            }
+        }
+    }
+    return true;
+}
+
+// texel centers at half integer coordinates ; clamped at the borders
+// pbrt 3rd edition, sec 10.4.2
+RGB MipMap::Bilinear (const int level, const Vec2 &uv) const {
+    const Level &l = levels[level];
+    const float s = uv.u * l.W - 0.5f, t = uv.v * l.H - 0.5f;
+    const float fs = floorf(s), ft = floorf(t);
+    const float ds = s - fs, dt = t - ft;
+    const int x0 = std::min(std::max((int)fs, 0), l.W - 1), x1 = std::min(std::max((int)fs + 1, 0), l.W - 1);
+    const int y0 = std::min(std::max((int)ft, 0), l.H - 1), y1 = std::min(std::max((int)ft + 1, 0), l.H - 1);
+
+    return (texel(l, x0, y0) * (1.f - ds) + texel(l, x1, y0) * ds) * (1.f - dt) +
+           (texel(l, x0, y1) * (1.f - ds) + texel(l, x1, y1) * ds) * dt;
+}
+
+// the level whose texels are as wide as the footprint, interpolated with
+// the next coarser one
+// pbrt 3rd edition, sec 10.4.3 (triangle filter)
+RGB MipMap::Lookup (const Vec2 &uv, const float width) const {
+    if (levels.empty()) return RGB(0., 0., 0.);
+    const int nLevels = Levels();
+    const float lod = log2f(std::max(width * std::max(levels[0].W, levels[0].H), 1e-8f));
+    // a NaN width (e.g., a degenerate ray cone) gives the finest level,
+    // an infinite one the coarsest
+    if (!(lod > 0.f)) return Bilinear(0, uv);
+    if (lod >= nLevels - 1) return Bilinear(nLevels - 1, uv);
+    const int l = (int)lod;
+    const float d = lod - l;
+    return Bilinear(l, uv) * (1.f - d) + Bilinear(l + 1, uv) * d;
+}
@@ -0,0 +1,60 @@
+//
+//  MipMap.hpp
+//  VI-RT-V4-PathTracing
+//
+//  an image prefiltered into a pyramid of levels, each half the resolution
+//  of the previous one, for filtered texture lookups: the level is selected
+//  from the width of the lookup's footprint and the two nearest levels are
+//  bilinearly interpolated (trilinear filtering)
+//  pbrt 3rd edition, sec 10.4 (pbrt.org)
+//
+//  the texels are stored as RGBA8 in 4x4 tiles: a tile is 64 bytes, one cache
+//  line, such that the 4 texels of a bilinear lookup are most often on the
+//  same line
+//
+
+#ifndef MipMap_hpp
+#define MipMap_hpp
+
+#include "image.hpp"
+#include "vector.hpp"
+#include <vector>
+
+class MipMap {
+public:
+    static const int tileSize = 4;
+    typedef struct {
+        unsigned char r, g, b, a;
+    } Texel;
+private:
+    typedef struct {
+        int W, H;
+        int tilesX;
+        int tileOffset;   // first tile of the level on texels
+    } Level;
+    std::vector<Level> levels;
+    std::vector<unsigned char> storage;
+    Texel *texels;   // 64 byte aligned, within storage
+
+    RGB texel (const Level &l, int x, int y) const {
+        const int tile = l.tileOffset + (y / tileSize) * l.tilesX + (x / tileSize);
+        const Texel &t = texels[tile * tileSize * tileSize + (y % tileSize) * tileSize + (x % tileSize)];
+        return RGB(t.r / 255.f, t.g / 255.f, t.b / 255.f);
+    }
+    RGB Bilinear (const int level, const Vec2 &uv) const;
+public:
+    MipMap (): texels(NULL) {}
+    MipMap (const MipMap &) = delete;   // texels points to storage
+    MipMap &operator= (const MipMap &) = delete;
+
+    // builds the pyramid from img, whose values are clamped to [0,1]
+    // returns false if img is empty
+    bool Build (const Image &img);
+    int Levels (void) const { return (int)levels.size(); }
+
+    // uv in [0,1]^2 ; width is the width of the footprint on texture
+    // coordinates (0: the finest level)
+    RGB Lookup (const Vec2 &uv, const float width) const;
+};
+
+#endif /* MipMap_hpp */
@@ -0,0 +1,230 @@
+//
+//  ATrous.hpp
+//  VI-RT-V4-PathTracing
+//
+//  denoiser guided by the auxiliary buffers of the frame (see AOVBuffer)
+//  edge-avoiding a-trous wavelet transform: H. Dammertz et al.,
+//  "Edge-Avoiding A-Trous Wavelet Transform for fast Global Illumination
+//  Filtering", HPG 2010 ; the luminance weights guided by the variance, and
+//  the normal and depth weights as in C. Schied et al., "Spatiotemporal
+//  Variance-Guided Filtering", HPG 2017
+//
+
+#ifndef ATrous_hpp
+#define ATrous_hpp
+
+#include "AOVBuffer.hpp"
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <cstdlib>
+
+// the color is demodulated by the albedo, such that only the illumination
+// is smoothed and the textures are kept ; then each iteration i convolves it
+// with a 5x5 B3 spline kernel whose taps are 2^i pixels apart, each tap
+// weighted by how similar its normal, depth and luminance are to the pixel's
+// the luminance differences are relative to the standard deviation of the
+// pixel's luminance: noise is smoothed, edges of the illumination are not
+// the pixels where no surface is hit (or a light source is) are not filtered
+class ATrous  {
+    // kept across frames
+    std::vector<RGB> c, cTmp;           // demodulated color
+    std::vector<float> l;               // its (compressed) luminance
+    std::vector<float> var, varTmp;     // variance of l
+    std::vector<float> dzdx, dzdy;      // depth gradient
+
+    // the luminance differences are measured after the same compression as
+    // the tone mapper's (see Reinhard), such that bright pixels do not dominate
+    static float Luminance (const RGB &C) {
+        const float Y = C.Y();
+        return Y / (1.f + Y);
+    }
+
+    // the weight of pixel q on pixel p due to their normals and depths is
+    // exp() of this ; (du,dv) is the offset of q from p
+    float GeometryExponent (const AOVBuffer &aov, const int p, const int q, const int du, const int dv) const {
+        const float zp = aov.depth[p];
+        // depth difference relative to its expected variation along the surface
+        const float dzExpected = sigmaDepth * (dzdx[p] * std::abs(du) + dzdy[p] * std::abs(dv)) + 1e-3f * zp;
+        const float dz = fabsf(zp - aov.depth[q]) / dzExpected;
+        // cos^sigmaNormal ; -inf if the normals are orthogonal or opposite
+        const float cosN = std::max(0.f, aov.normal[p].dot(aov.normal[q]));
+        return sigmaNormal * logf(cosN) - dz;
+    }
+
+    // c -> cTmp: a pixel brighter than all its neighbours is a firefly (a rare
+    // path of large contribution, which the filter would spread into a blotch):
+    // its luminance is clamped to the largest of theirs
+    void ClampFireflies (const AOVBuffer &aov) {
+        const int W = aov.W, H = aov.H;
+
+        #pragma omp parallel for schedule(static)
+        for (int y=0 ; y<H ; y++) {
+            for (int x=0 ; x<W ; x++) {
+                const int p = y*W + x;
+                cTmp[p] = c[p];
+                if (!aov.hit(p)) continue;
+                float maxY = -1.f;
+                for (int v=-1 ; v<=1 ; v++) {
+                    const int qy = y + v;
+                    if (qy < 0 || qy >= H) continue;
+                    for (int u=-1 ; u<=1 ; u++) {
+                        const int qx = x + u;
+                        if (qx < 0 || qx >= W || (u == 0 && v == 0)) continue;
+                        const int q = qy*W + qx;
+                        if (aov.hit(q)) maxY = std::max(maxY, c[q].Y());
+                    }
+                }
+                const float Y = c[p].Y();
+                if (maxY >= 0.f && Y > maxY) cTmp[p] = cTmp[p] * (maxY / Y);
+            }
+        }
+    }
+
+    // the variance of each pixel's luminance, estimated from its 5x5
+    // neighbourhood (the surfaces similar to the pixel's only)
+    void EstimateVariance (const AOVBuffer &aov) {
+        const int W = aov.W, H = aov.H;
+
+        #pragma omp parallel for schedule(dynamic, 4)
+        for (int y=0 ; y<H ; y++) {
+            for (int x=0 ; x<W ; x++) {
+                const int p = y*W + x;
+                if (!aov.hit(p)) {
+                    var[p] = 0.f;
+                    continue;
+                }
+                float wSum = 0.f, m1 = 0.f, m2 = 0.f;
+                for (int v=-2 ; v<=2 ; v++) {
+                    const int qy = y + v;
+                    if (qy < 0 || qy >= H) continue;
+                    for (int u=-2 ; u<=2 ; u++) {
+                        const int qx = x + u;
+                        if (qx < 0 || qx >= W) continue;
+                        const int q = qy*W + qx;
+                        if (!aov.hit(q)) continue;
+                        const float w = expf(GeometryExponent(aov, p, q, u, v));
+                        wSum += w;
+                        m1 += w * l[q];
+                        m2 += w * l[q] * l[q];
+                    }
+                }
+                // the pixel's own weight is 1 unless its features are degenerate
+                if (!(wSum > 0.f)) {
+                    var[p] = 0.f;
+                    continue;
+                }
+                m1 /= wSum;
+                var[p] = std::max(0.f, m2 / wSum - m1 * m1);
+            }
+        }
+    }
+
+    // one iteration: c, var -> cTmp, varTmp
+    void Iteration (const AOVBuffer &aov, const int step) {
+        static const float h[5] = {1.f/16.f, 1.f/4.f, 3.f/8.f, 1.f/4.f, 1.f/16.f};
+        const int W = aov.W, H = aov.H;
+
+        #pragma omp parallel for schedule(dynamic, 4)
+        for (int y=0 ; y<H ; y++) {
+            for (int x=0 ; x<W ; x++) {
+                const int p = y*W + x;
+                if (!aov.hit(p)) {
+                    cTmp[p] = c[p];
+                    varTmp[p] = var[p];
+                    continue;
+                }
+                const float lp = l[p];
+                const float invSigmaL = 1.f / (sigmaLuminance * sqrtf(var[p]) + 1e-4f);
+                RGB sum(0., 0., 0.);
+                float wSum = 0.f, varSum = 0.f;
+                for (int v=-2 ; v<=2 ; v++) {
+                    const int qy = y + v*step;
+                    if (qy < 0 || qy >= H) continue;
+                    for (int u=-2 ; u<=2 ; u++) {
+                        const int qx = x + u*step;
+                        if (qx < 0 || qx >= W) continue;
+                        const int q = qy*W + qx;
+                        if (!aov.hit(q)) continue;
+
+                        const float w = h[u+2] * h[v+2] *
+                                        expf(GeometryExponent(aov, p, q, u*step, v*step) - fabsf(lp - l[q]) * invSigmaL);
+                        RGB Cq = c[q];
+                        sum += Cq * w;
+                        wSum += w;
+                        varSum += w * w * var[q];
+                    }
+                }
+                if (!(wSum > 0.f)) {
+                    cTmp[p] = c[p];
+                    varTmp[p] = var[p];
+                    continue;
+                }
+                cTmp[p] = sum / wSum;
+                varTmp[p] = varSum / (wSum * wSum);
+            }
+        }
+    }
+
+public:
+    int iterations;        // the kernel is 4 * 2^iterations + 1 pixels wide
+    float sigmaLuminance;  // of the luminance differences, in standard deviations
+    float sigmaNormal;     // exponent of the cosine between the normals
+    float sigmaDepth;      // of the depth differences, in units of the depth gradient
+
+    ATrous (int _iterations=5, float _sigmaLuminance=4.f, float _sigmaNormal=128.f, float _sigmaDepth=1.f):
+        iterations(_iterations), sigmaLuminance(_sigmaLuminance), sigmaNormal(_sigmaNormal), sigmaDepth(_sigmaDepth) {}
+
+    void Filter (int const W, int const H, const AOVBuffer &aov, const RGB *imageIn, RGB *imageOut) {
+        const float minAlbedo = 0.01f;
+        c.resize(W*H);
+        cTmp.resize(W*H);
+        l.resize(W*H);
+        var.resize(W*H);
+        varTmp.resize(W*H);
+        dzdx.resize(W*H);
+        dzdy.resize(W*H);
+
+        #pragma omp parallel for schedule(static)
+        for (int p=0 ; p<W*H ; p++) {
+            const RGB &a = aov.albedo[p];
+            RGB C = imageIn[p];
+            c[p] = C / RGB(std::max(a.R, minAlbedo), std::max(a.G, minAlbedo), std::max(a.B, minAlbedo));
+        }
+        // the smaller of the forward and backward differences, such that
+        // the gradient does not jump at depth discontinuities
+        #pragma omp parallel for schedule(static)
+        for (int y=0 ; y<H ; y++) {
+            for (int x=0 ; x<W ; x++) {
+                const int p = y*W + x;
+                float gx = INFINITY, gy = INFINITY;
+                if (x > 0 && aov.hit(p-1)) gx = std::min(gx, fabsf(aov.depth[p] - aov.depth[p-1]));
+                if (x < W-1 && aov.hit(p+1)) gx = std::min(gx, fabsf(aov.depth[p] - aov.depth[p+1]));
+                if (y > 0 && aov.hit(p-W)) gy = std::min(gy, fabsf(aov.depth[p] - aov.depth[p-W]));
+                if (y < H-1 && aov.hit(p+W)) gy = std::min(gy, fabsf(aov.depth[p] - aov.depth[p+W]));
+                dzdx[p] = (gx < INFINITY ? gx : 0.f);
+                dzdy[p] = (gy < INFINITY ? gy : 0.f);
+            }
+        }
+
+        ClampFireflies(aov);
+        c.swap(cTmp);
+
+        for (int i=0 ; i<iterations ; i++) {
+            #pragma omp parallel for schedule(static)
+            for (int p=0 ; p<W*H ; p++) l[p] = Luminance(c[p]);
+            if (i == 0) EstimateVariance(aov);
+            Iteration(aov, 1 << i);
+            c.swap(cTmp);
+            var.swap(varTmp);
+        }
+
+        #pragma omp parallel for schedule(static)
+        for (int p=0 ; p<W*H ; p++) {
+            const RGB &a = aov.albedo[p];
+            imageOut[p] = c[p] * RGB(std::max(a.R, minAlbedo), std::max(a.G, minAlbedo), std::max(a.B, minAlbedo));
+        }
+    }
+};
+
+#endif /* ATrous_hpp */
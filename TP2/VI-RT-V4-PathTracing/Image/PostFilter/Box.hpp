@@ -12,12 +12,23 @@
 
 class Box  {
 
-    const int margin=3;
-    const int hmargin=1;
     const float mSq = margin*margin;
 
 public:
+    static const int margin=3;
+    static const int hmargin=1;
+
     Box () {}
+    // mean of the luminances Y (W per row) around (x,y)
+    float FilterY (const float *Y, int const W, int const x, int const y) const {
+        float sumL=0.f;
+        for (int v=-hmargin ; v<(hmargin+1) ; v++) {
+            for (int u=-hmargin ; u<(hmargin+1) ; u++) {
+                sumL += Y[(y+v)*W + x+u];
+            }
+        }
+        return sumL / mSq;
+    }
     void Filter (int const W, int const H, RGB *imageIn, RGB *imageOut) {
         for (int y=hmargin ; y<H-hmargin ; y++) {
             int const row_off = y*W;
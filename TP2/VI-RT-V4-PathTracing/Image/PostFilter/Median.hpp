@@ -9,41 +9,103 @@
 #define Median_hpp
 
 #include "vector.hpp"
-#include <vector>
+#include "RGB.hpp"
 #include <algorithm>
+#include <math.h>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
 
-class Median  {
-    const int margin=5;
-    const int hmargin=2;
-    const int median_ndx = 12;
+// compare and exchange, branch free: a <= b afterwards
+static inline void SortPair (float &a, float &b) {
+    const float t = std::min(a, b);
+    b = std::max(a, b);
+    a = t;
+}
+#ifdef __SSE__
+static inline void SortPair (__m128 &a, __m128 &b) {
+    const __m128 t = _mm_min_ps(a, b);
+    b = _mm_max_ps(a, b);
+    a = t;
+}
+#endif
 
+// Batcher's odd-even merge sorting network for n elements (n a power of 2):
+// a fixed sequence of compare and exchanges, independent of the data
+// K. E. Batcher, "Sorting Networks and their Applications", AFIPS 1968
+template <class T, int n>
+static inline void BatcherSort (T *a) {
+    for (int p = 1; p < n; p *= 2) {
+        for (int k = p; k >= 1; k /= 2) {
+            for (int j = k % p; j <= n - 1 - k; j += 2 * k) {
+                for (int i = 0; i <= std::min(k - 1, n - j - k - 1); i++) {
+                    if ((i + j) / (p * 2) == (i + j + k) / (p * 2)) SortPair(a[i + j], a[i + j + k]);
+                }
+            }
+        }
+    }
+}
+
+// the luminance of each pixel is replaced by the median of its 5x5 neighbourhood
+// (pixels closer than hmargin to the border are not filtered)
+class Median  {
 public:
+    static const int margin=5;
+    static const int hmargin=2;
+    static const int median_ndx = 12;
+
     Median () {}
+
+    // median of the luminances Y (W per row) around (x,y)
+    // the 25 values are padded with +inf to the 32 of the network
+    float FilterY (const float *Y, int const W, int const x, int const y) const {
+        float window[32];
+        int k = 0;
+        for (int v=-hmargin ; v<(hmargin+1) ; v++) {
+            for (int u=-hmargin ; u<(hmargin+1) ; u++) {
+                window[k++] = Y[(y+v)*W + x+u];
+            }
+        }
+        for ( ; k<32 ; k++) window[k] = INFINITY;
+        BatcherSort<float, 32>(window);
+        return window[median_ndx];
+    }
+#ifdef __SSE__
+    // the same for pixels (x,y) .. (x+3,y): lane i of window element k holds
+    // element k of the window of pixel x+i
+    void FilterY4 (const float *Y, int const W, int const x, int const y, float Lout[4]) const {
+        __m128 window[32];
+        int k = 0;
+        for (int v=-hmargin ; v<(hmargin+1) ; v++) {
+            for (int u=-hmargin ; u<(hmargin+1) ; u++) {
+                window[k++] = _mm_loadu_ps(&Y[(y+v)*W + x+u]);
+            }
+        }
+        for ( ; k<32 ; k++) window[k] = _mm_set1_ps(INFINITY);
+        BatcherSort<__m128, 32>(window);
+        _mm_storeu_ps(Lout, window[median_ndx]);
+    }
+#endif
+
     void Filter (int const W, int const H, RGB *imageIn, RGB *imageOut) {
+        float *Y = new float[W*H];
+        for (int i=0 ; i<W*H ; i++) Y[i] = imageIn[i].Y();
         for (int y=hmargin ; y<H-hmargin ; y++) {
             int const row_off = y*W;
             for (int x=hmargin ; x<W-hmargin ; x++) {
                 int const offset = row_off + x;
                 RGB  Cin = imageIn[offset];
-                float const Lin = Cin.Y();
-                if (abs(Lin) < EPSILON ) {
+                float const Lin = Y[offset];
+                if (fabsf(Lin) < EPSILON ) {
                     imageOut[offset] = Cin;
                     continue;
                 }
-                std::vector<float> window;
-                for (int v=-hmargin ; v<(hmargin+1) ; v++) {
-                    int const row_off_uv = (y+v)*W;
-                    for (int u=-hmargin ; u<(hmargin+1) ; u++) {
-                        int const offset_uv = row_off_uv + x+u;
-                        window.push_back(imageIn[offset_uv].Y());
-                    }
-                }
-                std::sort(window.begin(), window.end());
-                float  Lout = window[median_ndx];
+                float  Lout = FilterY(Y, W, x, y);
                 RGB Cout = Cin * Lout / Lin;
                 imageOut[offset] = Cout;
             }
         }
+        delete[] Y;
     }
 };
 
@@ -0,0 +1,69 @@
+//
+//  PostProcess.cpp
+//  VI-RT-V4-PathTracing
+//
+
+#include "PostProcess.hpp"
+#include <math.h>
+#include <algorithm>
+
+void PostProcess::Finish (RGB C, bool const filtered, float const Lin, float const Lout, char_pixel &out) const {
+    if (filtered && fabsf(Lin) >= EPSILON) C = C * Lout / Lin;
+    if (toneMap) C = reinhard.Map(C);
+    if (gamma != 1.f) {
+        const float e = 1.f / gamma;
+        C.R = powf(fmaxf(C.R, 0.f), e);
+        C.G = powf(fmaxf(C.G, 0.f), e);
+        C.B = powf(fmaxf(C.B, 0.f), e);
+    }
+    // clamp and convert to byte format
+    out.val[0] = (unsigned char)(fmax(fmin(1.f, C.R),0.f) * 255);
+    out.val[1] = (unsigned char)(fmax(fmin(1.f, C.G),0.f) * 255);
+    out.val[2] = (unsigned char)(fmax(fmin(1.f, C.B),0.f) * 255);
+}
+
+void PostProcess::Run (int const W, int const H, const RGB *image, char_pixel *out) {
+    if (aov != NULL && aov->W == W && aov->H == H) {
+        denoised.resize(W * H);
+        denoiser.Filter(W, H, *aov, image, denoised.data());
+        image = denoised.data();
+    }
+    const int m = (filter == FILTER_MEDIAN ? Median::hmargin : (filter == FILTER_BOX ? Box::hmargin : 0));
+    if (filter != FILTER_NONE) {
+        Y.resize(W * H);
+        #pragma omp parallel for schedule(static)
+        for (int i = 0; i < W * H; i++) Y[i] = image[i].Y();
+    }
+
+    const int nTiles = (H + tileRows - 1) / tileRows;
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int t = 0; t < nTiles; t++) {
+        const int y1 = std::min(H, (t + 1) * tileRows);
+        for (int y = t * tileRows; y < y1; y++) {
+            // pixels closer than m to the border are not filtered
+            const bool rowFiltered = (filter != FILTER_NONE && y >= m && y < H - m);
+            int x = 0;
+            while (x < W) {
+                const int i = y * W + x;
+                if (!rowFiltered || x < m || x >= W - m) {
+                    Finish(image[i], false, 0.f, 0.f, out[i]);
+                    x++;
+                    continue;
+                }
+#ifdef __SSE__
+                // 4 medians at once
+                if (filter == FILTER_MEDIAN && x + 4 <= W - m) {
+                    float Lout[4];
+                    median.FilterY4(Y.data(), W, x, y, Lout);
+                    for (int k = 0; k < 4; k++) Finish(image[i + k], true, Y[i + k], Lout[k], out[i + k]);
+                    x += 4;
+                    continue;
+                }
+#endif
+                const float Lout = (filter == FILTER_MEDIAN ? median.FilterY(Y.data(), W, x, y) : box.FilterY(Y.data(), W, x, y));
+                Finish(image[i], true, Y[i], Lout, out[i]);
+                x++;
+            }
+        }
+    }
+}
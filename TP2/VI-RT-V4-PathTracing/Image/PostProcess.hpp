@@ -0,0 +1,58 @@
+//
+//  PostProcess.hpp
+//  VI-RT-V4-PathTracing
+//
+//  conversion of a rendered image to 8 bit pixels, as a sequence of stages
+//  (filter -> tone map -> gamma -> quantize) applied to each pixel in a single
+//  pass over tiles of rows, in parallel ; optionally preceded by the denoiser
+//  (see ATrous), which is a pass over the whole image
+//  the filters (see Box and Median) replace the luminance of a pixel by a
+//  function of its neighbourhood's, hence the luminance of the whole image
+//  is computed first ; the buffers are kept across frames
+//
+
+#ifndef PostProcess_hpp
+#define PostProcess_hpp
+
+#include "image.hpp"
+#include "Box.hpp"
+#include "Median.hpp"
+#include "Reinhard.hpp"
+#include "ATrous.hpp"
+#include <vector>
+
+class PostProcess {
+public:
+    typedef enum {
+        FILTER_NONE,
+        FILTER_BOX,
+        FILTER_MEDIAN
+    } FilterType;
+
+    FilterType filter;
+    bool toneMap;      // Reinhard
+    float gamma;       // 1: none
+    // if not NULL the image is denoised first, guided by these buffers
+    // (of the same size as the image)
+    const AOVBuffer *aov;
+
+    PostProcess (FilterType _filter=FILTER_NONE, bool _toneMap=true, float _gamma=1.f):
+        filter(_filter), toneMap(_toneMap), gamma(_gamma), aov(NULL) {}
+
+    void Run (int const W, int const H, const RGB *image, char_pixel *out);
+
+private:
+    static const int tileRows = 8;
+    std::vector<float> Y;   // luminance of the image (filters only)
+    std::vector<RGB> denoised;
+    ATrous denoiser;
+    Box box;
+    Median median;
+    Reinhard reinhard;
+
+    // the stages after the filter, for one pixel ; if filtered its luminance
+    // Lin is replaced by Lout
+    void Finish (RGB C, bool const filtered, float const Lin, float const Lout, char_pixel &out) const;
+};
+
+#endif /* PostProcess_hpp */
@@ -8,19 +8,22 @@
 #ifndef Reinhard_hpp
 #define Reinhard_hpp
 
+#include "RGB.hpp"
+
 class Reinhard  {
 
 public:
     Reinhard () {}
+    RGB Map (RGB Cin) const {
+        float Lin = Cin.Y();
+        return Cin / (1. + Lin);
+    }
     void ToneMap (int const W, int const H, RGB *imageIn, RGB *imageOut) {
         for (int y=0 ; y<H ; y++) {
             int const row_off = y*W;
             for (int x=0 ; x<W ; x++) {
                 int const offset = row_off + x;
-                RGB Cin = imageIn[offset];
-                float Lin = Cin.Y();
-                RGB const Cout = Cin / (1. + Lin);
-                imageOut[offset] = Cout;
+                imageOut[offset] = Map(imageIn[offset]);
             }
         }
     }
@@ -27,10 +27,10 @@ public:
         imagePlane = new RGB[W*H];
         memset((void *)imagePlane, 0, W*H*sizeof(RGB));  // set image plane to 0
     }
-    ~Image() {
+    virtual ~Image() {
         if (imagePlane!=NULL) delete[] imagePlane;
     }
-    RGB get (int x, int y) {
+    RGB get (int x, int y) const {
         if (x>W or y>H) return RGB(0.,0.,0.);
         return imagePlane[y*W+x];
     }
@@ -39,6 +39,12 @@ public:
         imagePlane[y*W+x] = rgb;
         return true;
     }
+    // copies a w x h block of pixels (row major) with upper left corner at (x0,y0)
+    void setBlock (int x0, int y0, int w, int h, const RGB *block) {
+        for (int y=0 ; y<h ; y++) {
+            memcpy((void *)&imagePlane[(y0+y)*W+x0], (const void *)&block[y*w], w*sizeof(RGB));
+        }
+    }
     bool add (int x, int y, const RGB &rgb) {
         if (x>W or y>H) return false;
         imagePlane[y*W+x] += rgb;
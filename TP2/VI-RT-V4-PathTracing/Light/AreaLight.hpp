@@ -41,11 +41,13 @@ public:
         return intensity;
     }
     // return a point p, RGB radiance and pdf given a pair of random number in [0..[
+    // (does not write any member, since it is called concurrently by many threads)
     RGB Sample_L (float *r, Point *p, float& _pdf) {
-        intensity = Sample_L (r, p);
         _pdf = pdf;
-        return intensity;
+        return Sample_L (r, p);
     }
+    // one sided diffuse emitter: radiance * PI * area
+    float Power () {return M_PI * power.Y() * gem->area();}
 };
 
 #endif /* AreaLight_hpp */
@@ -3,37 +3,36 @@
 
 #include "light.hpp"
 #include "ImageHDR.hpp"
+#include "ImageCache.hpp"
+#include <memory>
 
 #include <stdlib.h>
 #include <math.h>
 
 class EnvironmentLight: public Light {
 public:
-    ImageHDR hdrImage;
+    // shared with the other lights using the same probe (see ImageCache)
+    std::shared_ptr<const ImageHDR> hdrImage;
 
-    EnvironmentLight(const std::string& filename): hdrImage(filename){ type = ENVIRONMENT_LIGHT; }
+    EnvironmentLight(const std::string& filename): hdrImage(ImageCache::HDR(filename)){ type = ENVIRONMENT_LIGHT; }
 
     ~EnvironmentLight () {}
 
     // return the Light RGB radiance from a direction
-    RGB L(const Vector& dir) const { return hdrImage.SampleDirection(dir); }
+    RGB L(const Vector& dir) const { return hdrImage->SampleDirection(dir); }
+    // the radiance from n directions at once
+    void L(const int n, const Vector* dirs, RGB* radiance) const { hdrImage->SampleDirections(n, dirs, radiance); }
 
-    // return a point p and RGB radiance for a given probability pair prob[2]
+    // return a direction dir and its RGB radiance for a given probability pair rand[2]
+    // directions are importance sampled from the probe's luminance (see ImageHDR)
+    // pdf is the solid angle density of dir ; it is 0 if the sample was wasted
     RGB Sample_L  (float* rand, Vector* dir, float& pdf) const {
-        float z = 1.0f - 2.0f * rand[0];
-        float phi = 2.0f * M_PI * rand[1];
-        float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
-
-        float x = r * std::cos(phi);
-        float y = r * std::sin(phi);
-
-        *dir = Vector(x, y, z);
-        dir->normalize();
-        
-        pdf = 1.0f / (4.0f * M_PI);  // PDF uniforme na esfera
-
-        return hdrImage.SampleDirection(*dir);
+        if (!hdrImage->SampleImportance(rand, dir, &pdf)) return RGB();
+        return hdrImage->SampleDirection(*dir);
     }
+
+    // solid angle density of Sample_L() returning direction dir
+    float pdf (const Vector& dir) const { return hdrImage->Pdf(dir); }
 };
 
 #endif /* EnvironmentLight_hpp */
\ No newline at end of file
@@ -9,6 +9,7 @@
 #define PointLight_hpp
 
 #include "light.hpp"
+#include <math.h>
 
 class PointLight: public Light {
 public:
@@ -24,6 +25,8 @@ public:
         *p = pos;
         return color;
     }
+    // isotropic: intensity * 4 PI
+    float Power () {return 4.f * M_PI * color.Y();}
 };
 
 #endif /* PointLight_hpp */
@@ -23,7 +23,7 @@ class Light {
 public:
     LightType type;
     Light () {type=NO_LIGHT;}
-    ~Light () {}
+    virtual ~Light () {}
     // return the Light RGB radiance for a given point : p
     virtual RGB  L (Point p)  {return RGB();}
     // return the Light RGB radiance
@@ -33,6 +33,10 @@ public:
     virtual RGB   Sample_L (float *prob, Point *p, float &pdf)  {return RGB();}
     // return the probability of p
     virtual float  pdf(Point p)  {return 0.;}
+    // return the total emitted power (luminance, see RGB::Y())
+    // 0 if it is not finite (e.g., ambient and environment lights)
+    // pbrt 4th edition, sec 12.1 (Light::Phi())
+    virtual float  Power ()  {return 0.;}
 
 };
 
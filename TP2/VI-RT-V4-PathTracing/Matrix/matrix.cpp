@@ -101,6 +101,70 @@ void Matrix::addTranslation(float x, float y, float z, int frame, int totalFrame
   delete[] scaleMatrix;
 }
 
+void Matrix::setKeyframe(std::string type, float angle, float x, float y, float z, int frame, int totalFrames, std::vector<int> models_indexes) {
+  this->type = type;
+  this->angle = angle;
+  this->x = x;
+  this->y = y;
+  this->z = z;
+  this->frame = frame;
+  this->totalFrames = totalFrames;
+  this->models_indexes = models_indexes;
+  evaluate(frame + totalFrames, this->data);
+}
+
+int Matrix::steps(int f) const {
+  const int n = f - frame + 1;
+  if (n < 0) return 0;
+  return (n > totalFrames ? totalFrames : n);
+}
+
+// a fraction t of the keyframe: t of the translation and of the rotation angle,
+// the scale to the power of t
+void Matrix::evaluate(int f, float (*result)[4]) const {
+  Matrix m;
+  const int n = steps(f);
+  if (n > 0) {
+    const float t = (float)n / totalFrames;
+    if (type == "translate") {
+      m.addTranslation(t * x, t * y, t * z, frame, totalFrames, models_indexes);
+    } else if (type == "rotate") {
+      m.addRotation(x, y, z, t * angle, frame, totalFrames, models_indexes);
+    } else if (type == "scale") {
+      m.addScale(pow(x, t), pow(y, t), pow(z, t), frame, totalFrames, models_indexes);
+    }
+  }
+  for (int i = 0; i < 4; i++) {
+    for (int j = 0; j < 4; j++) {
+      result[i][j] = m.data[i][j];
+    }
+  }
+  delete[] m.data;
+}
+
+bool Matrix::overlaps(const Matrix& m) const {
+  if (frame >= m.frame + m.totalFrames || m.frame >= frame + totalFrames) return false;
+  for (int i : models_indexes) {
+    for (int j : m.models_indexes) {
+      if (i == j) return true;
+    }
+  }
+  return false;
+}
+
+bool Matrix::commutes(const Matrix& m) const {
+  const bool uniform = (type == "scale" && x == y && y == z);
+  const bool mUniform = (m.type == "scale" && m.x == m.y && m.y == m.z);
+  if (type == m.type && type != "rotate") return true;
+  if ((type == "rotate" && mUniform) || (m.type == "rotate" && uniform)) return true;
+  if (type == "rotate" && m.type == "rotate") {
+    // parallel axes
+    const float cx = y * m.z - z * m.y, cy = z * m.x - x * m.z, cz = x * m.y - y * m.x;
+    return cx * cx + cy * cy + cz * cz <= 1e-12f * (x * x + y * y + z * z) * (m.x * m.x + m.y * m.y + m.z * m.z);
+  }
+  return false;
+}
+
 // modifies the original
 void Matrix::transformPoint(float *vector, int isPoint) {
   float(*result) = new float[4];
@@ -1,6 +1,7 @@
 #pragma once
 #include <iostream>
 #include <vector>
+#include <string>
 
 class Matrix {
    public:
@@ -10,13 +11,31 @@ class Matrix {
     void addRotation(float x, float y, float z, float angle, int frame, int totalFrames, std::vector<int> models_indexes);
     void addScale(float x, float y, float z, int frame, int totalFrames, std::vector<int> models_indexes);
     void addTranslation(float x, float y, float z, int frame, int totalFrames, std::vector<int> models_indexes);
+    // a transformation ("translate", "rotate" or "scale") spread evenly over
+    // totalFrames frames, starting at frame ; data is set to the whole transformation
+    void setKeyframe(std::string type, float angle, float x, float y, float z, int frame, int totalFrames, std::vector<int> models_indexes);
+    // number of the keyframe's steps applied at the end of frame f, in [0, totalFrames]
+    int steps(int f) const;
+    // the part of the keyframe's transformation applied at the end of frame f,
+    // evaluated directly (not accumulated over the previous frames)
+    // a model is transformed by its keyframes in the order of their start
+    // frames (see matrixesCheck()): the same as applying their steps frame by
+    // frame as long as the keyframes that overlap in time commute (see checkXML())
+    void evaluate(int f, float (*result)[4]) const;
+    // the keyframes are active on some common frame and transform some common model
+    bool overlaps(const Matrix& m) const;
+    // the order the keyframes are applied in does not matter: both translations,
+    // both scales, rotations about the same axis, or a rotation and a uniform scale
+    bool commutes(const Matrix& m) const;
     void transformPoint(float* vector, int isPoint = 1);
     void deleteMatrix();
     float(*data)[4];
     int frame;
     int totalFrames;
     std::vector<int> models_indexes;
-
+    // keyframe (see setKeyframe())
+    std::string type;
+    float angle, x, y, z;
 
 
 private:
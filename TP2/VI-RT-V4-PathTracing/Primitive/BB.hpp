@@ -26,11 +26,44 @@ public:
     Point min, max;
     void update (Point p) {
         if (p.X < min.X) min.X = p.X;
-        else if (p.X > max.X) max.X = p.X;
+        if (p.X > max.X) max.X = p.X;
         if (p.Y < min.Y) min.Y = p.Y;
-        else if (p.Y > max.Y) max.Y = p.Y;
+        if (p.Y > max.Y) max.Y = p.Y;
         if (p.Z < min.Z) min.Z = p.Z;
-        else if (p.Z > max.Z) max.Z = p.Z;
+        if (p.Z > max.Z) max.Z = p.Z;
+    }
+    // an "inverted" box, such that any Union() or update() replaces it
+    void setEmpty (void) {
+        min.set(MAXFLOAT, MAXFLOAT, MAXFLOAT);
+        max.set(-MAXFLOAT, -MAXFLOAT, -MAXFLOAT);
+    }
+    // pbrt 3rd edition, sec 2.6, pag 78 .. 81 (pbrt.org)
+    void Union (const BB &b) {
+        min.set(fminf(min.X, b.min.X), fminf(min.Y, b.min.Y), fminf(min.Z, b.min.Z));
+        max.set(fmaxf(max.X, b.max.X), fmaxf(max.Y, b.max.Y), fmaxf(max.Z, b.max.Z));
+    }
+    Point Centroid (void) const {
+        return Point(.5f*(min.X+max.X), .5f*(min.Y+max.Y), .5f*(min.Z+max.Z));
+    }
+    Vector Diagonal (void) const {
+        return Vector(max.X-min.X, max.Y-min.Y, max.Z-min.Z);
+    }
+    float SurfaceArea (void) const {
+        const Vector d = Diagonal();
+        return 2.f * (d.X * d.Y + d.X * d.Z + d.Y * d.Z);
+    }
+    // index of the axis with the largest extent (0=X, 1=Y, 2=Z)
+    int MaximumExtent (void) const {
+        Vector d = Diagonal();
+        return d.MaxDimension();
+    }
+    // position of p relative to the box corners: (0,0,0) at min, (1,1,1) at max
+    Vector Offset (const Point &p) const {
+        Vector o(p.X-min.X, p.Y-min.Y, p.Z-min.Z);
+        if (max.X > min.X) o.X /= max.X - min.X;
+        if (max.Y > min.Y) o.Y /= max.Y - min.Y;
+        if (max.Z > min.Z) o.Z /= max.Z - min.Z;
+        return o;
     }
     /*
      * I suggest you implement:
@@ -42,66 +75,38 @@ public:
      *
      */
     // based on PBRT's 3rd ed. book , sec 3.1.2, pag 125.. 12 (pbrt.org)
+    // r.invDir and r.dirIsNeg must have been set with Ray::invertDir()
 #define BB_TEST
 #ifdef BB_TEST
-    bool intersect (Ray r) {
-        float t0 = 0.f, t1 = MAXFLOAT;
-        float invRayDir, tNear, tFar;
-        // XX slabs
-        invRayDir = (r.dir.X!=0.f ? 1.f / r.dir.X : 1.e5);
-        //invRayDir = r.invDir.X;
-        tNear = (min.X - r.o.X) * invRayDir;
-        tFar = (max.X - r.o.X) * invRayDir;
-        if (tNear > tFar) {
-            float aux = tNear;
-            tNear = tFar;
-            tFar = aux;
-        }
-        // pbrt 3rd edition, pag 221 (pbrt.org)
-        tFar *= 1 + 2 * gamma(3);
-        t0 = tNear > t0 ? tNear : t0;
-        t1 = tFar < t1 ? tFar : t1;
-        if (t0 > t1) return false;
-        // YY slabs
-        //invRayDir = 1 / r.dir.Y;
-        invRayDir = (r.dir.Y!=0.f ? 1.f / r.dir.Y : 1.e5);
-        //invRayDir = r.invDir.Y;
-        tNear = (min.Y - r.o.Y) * invRayDir;
-        tFar = (max.Y - r.o.Y) * invRayDir;
-        if (tNear > tFar) {
-            float aux = tNear;
-            tNear = tFar;
-            tFar = aux;
-        }
-        // pbrt 3rd edition, pag 221 (pbrt.org)
-        tFar *= 1 + 2 * gamma(3);
-        t0 = tNear > t0 ? tNear : t0;
-        t1 = tFar < t1 ? tFar : t1;
-        if (t0 > t1) return false;
-        // ZZ slabs
-        //invRayDir = 1 / r.dir.Z;
-        invRayDir = (r.dir.Z!=0.f ? 1.f / r.dir.Z : 1.e5);
-        //invRayDir = r.invDir.Z;
-        tNear = (min.Z - r.o.Z) * invRayDir;
-        tFar = (max.Z - r.o.Z) * invRayDir;
-        if (tNear > tFar) {
-            float aux = tNear;
-            tNear = tFar;
-            tFar = aux;
-        }
-        // pbrt 3rd edition, pag 221 (pbrt.org)
-        tFar *= 1 + 2 * gamma(3);
-        t0 = tNear > t0 ? tNear : t0;
-        t1 = tFar < t1 ? tFar : t1;
-        if (t0 > t1) return false;
-
-        return true;
+    bool intersect (const Ray &r) const {
+        return IntersectP(r, MAXFLOAT);
     }
 #else
-    bool intersect (Ray r) {
+    bool intersect (const Ray &r) const {
         return true;
     }
 #endif
+    // slab test against [0, tMax[ used by the BVH traversal
+    // the slab planes are selected with the ray direction signs, hence
+    // tNear <= tFar on each axis and no swap (nor division) is required
+    // pbrt 3rd edition, sec 3.9.2, pag 128 (pbrt.org)
+    // a ray parallel to a slab, with its origin on one of the slab's planes,
+    // gives 0 * inf = NaN on that axis: fmaxf() and fminf() return their other
+    // operand, hence the axis is ignored (the ray is on the box's boundary)
+    // and the last operands (0 and tMax) are never NaN
+    bool IntersectP (const Ray &r, const float tMax) const {
+        const Point *bounds[2] = {&min, &max};
+        const float txNear = (bounds[r.dirIsNeg[0]]->X - r.o.X) * r.invDir.X;
+        const float txFar = (bounds[1-r.dirIsNeg[0]]->X - r.o.X) * r.invDir.X;
+        const float tyNear = (bounds[r.dirIsNeg[1]]->Y - r.o.Y) * r.invDir.Y;
+        const float tyFar = (bounds[1-r.dirIsNeg[1]]->Y - r.o.Y) * r.invDir.Y;
+        const float tzNear = (bounds[r.dirIsNeg[2]]->Z - r.o.Z) * r.invDir.Z;
+        const float tzFar = (bounds[1-r.dirIsNeg[2]]->Z - r.o.Z) * r.invDir.Z;
+        const float t0 = fmaxf(fmaxf(txNear, tyNear), fmaxf(tzNear, 0.f));
+        // pbrt 3rd edition, pag 221 (pbrt.org)
+        const float t1 = fminf(fminf(txFar, tyFar), fminf(tzFar, tMax)) * (1 + 2 * gamma(3));
+        return t0 <= t1;
+    }
 } BB;
 
 #endif /* AABB_hpp */
@@ -0,0 +1,160 @@
+//
+//  BB4.hpp
+//  VI-RT-V4-PathTracing
+//
+//  four axis aligned bounding boxes in SoA layout,
+//  such that a ray is tested against all of them at once (SSE)
+//
+
+#ifndef BB4_hpp
+#define BB4_hpp
+
+#include "BB.hpp"
+#include "ray.hpp"
+#include "RayPacket.hpp"
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+// the slab distances of a ray parallel to a slab, with its origin on one of
+// the slab's planes, are NaN (0 * inf): the axis is ignored (see
+// BB::IntersectP()), as if the entry distance was -inf and the exit one +inf
+static inline float ifNaN (const float t, const float v) { return (t != t ? v : t); }
+#ifdef __SSE__
+static inline __m128 ifNaN (const __m128 t, const __m128 v) {
+    const __m128 nan = _mm_cmpunord_ps(t, t);
+    return _mm_or_ps(_mm_and_ps(nan, v), _mm_andnot_ps(nan, t));
+}
+#endif
+
+typedef struct BB4 {
+    float minX[4], minY[4], minZ[4];
+    float maxX[4], maxY[4], maxZ[4];
+
+    void set (const int i, const BB &b) {
+        minX[i] = b.min.X; minY[i] = b.min.Y; minZ[i] = b.min.Z;
+        maxX[i] = b.max.X; maxY[i] = b.max.Y; maxZ[i] = b.max.Z;
+    }
+    // an empty slot is never intersected (tNear = +inf, tFar = -inf)
+    void setEmpty (const int i) {
+        minX[i] = minY[i] = minZ[i] = INFINITY;
+        maxX[i] = maxY[i] = maxZ[i] = -INFINITY;
+    }
+    BB get (const int i) const {
+        BB b;
+        b.min.set(minX[i], minY[i], minZ[i]);
+        b.max.set(maxX[i], maxY[i], maxZ[i]);
+        return b;
+    }
+    // branch free slab test of the ray against the 4 boxes on [0, tMax[
+    // returns a bit mask with bit i set if box i is intersected;
+    // tNear[i] is the ray parameter at which box i is entered
+    // r.invDir and r.dirIsNeg must have been set with Ray::invertDir()
+    // see BB::IntersectP()
+    int intersect (const Ray &r, const float tMax, float tNear[4]) const {
+        const float *nearX = (r.dirIsNeg[0] ? maxX : minX);
+        const float *farX  = (r.dirIsNeg[0] ? minX : maxX);
+        const float *nearY = (r.dirIsNeg[1] ? maxY : minY);
+        const float *farY  = (r.dirIsNeg[1] ? minY : maxY);
+        const float *nearZ = (r.dirIsNeg[2] ? maxZ : minZ);
+        const float *farZ  = (r.dirIsNeg[2] ? minZ : maxZ);
+#ifdef __SSE__
+        const __m128 oX = _mm_set1_ps(r.o.X), iX = _mm_set1_ps(r.invDir.X);
+        const __m128 oY = _mm_set1_ps(r.o.Y), iY = _mm_set1_ps(r.invDir.Y);
+        const __m128 oZ = _mm_set1_ps(r.o.Z), iZ = _mm_set1_ps(r.invDir.Z);
+        const __m128 t0X = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(nearX), oX), iX);
+        const __m128 t1X = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(farX), oX), iX);
+        const __m128 t0Y = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(nearY), oY), iY);
+        const __m128 t1Y = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(farY), oY), iY);
+        const __m128 t0Z = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(nearZ), oZ), iZ);
+        const __m128 t1Z = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(farZ), oZ), iZ);
+        // _mm_max_ps() and _mm_min_ps() return their second operand if either
+        // is NaN (0 * inf, see BB::IntersectP()): it is never NaN here
+        const __m128 t0 = _mm_max_ps(t0X, _mm_max_ps(t0Y, _mm_max_ps(t0Z, _mm_setzero_ps())));
+        // pbrt 3rd edition, pag 221 (pbrt.org)
+        const __m128 t1 = _mm_mul_ps(_mm_min_ps(t1X, _mm_min_ps(t1Y, _mm_min_ps(t1Z, _mm_set1_ps(tMax)))),
+                                     _mm_set1_ps(1 + 2 * gamma(3)));
+        _mm_storeu_ps(tNear, t0);
+        return _mm_movemask_ps(_mm_cmple_ps(t0, t1));
+#else
+        // fmaxf() and fminf() ignore a NaN operand (see BB::IntersectP())
+        int mask = 0;
+        for (int i=0 ; i<4 ; i++) {
+            const float t0 = fmaxf(fmaxf((nearX[i] - r.o.X) * r.invDir.X, (nearY[i] - r.o.Y) * r.invDir.Y),
+                                   fmaxf((nearZ[i] - r.o.Z) * r.invDir.Z, 0.f));
+            const float t1 = fminf(fminf((farX[i] - r.o.X) * r.invDir.X, (farY[i] - r.o.Y) * r.invDir.Y),
+                                   fminf((farZ[i] - r.o.Z) * r.invDir.Z, tMax)) * (1 + 2 * gamma(3));
+            tNear[i] = t0;
+            mask |= (t0 <= t1) << i;
+        }
+        return mask;
+#endif
+    }
+    // conservative test of a whole packet of rays against the 4 boxes, the
+    // rays' ranges being [0, t[ with t in [tMin, tMax]
+    // returns a bit mask with bit i cleared if box i is missed by all the rays
+    // of the packet, and sets on all the bits of the boxes entered by every ray ;
+    // tNear[i] is a lower bound of the rays' entry distance in box i
+    // the slab distances are bounded with interval arithmetic over the
+    // packet's origins and direction reciprocals (see RayPacket)
+    // p.coherent must be true: all rays share dirIsNeg, hence the near and far
+    // planes, and the floating point rounding is monotone, such that the result
+    // agrees with intersect() for each of the rays
+    int intersect (const RayPacket &p, const float tMin, const float tMax, float tNear[4], int *all) const {
+        const Ray &r = p.r[0];
+        const float *nearA[3] = { (r.dirIsNeg[0] ? maxX : minX), (r.dirIsNeg[1] ? maxY : minY), (r.dirIsNeg[2] ? maxZ : minZ) };
+        const float *farA[3]  = { (r.dirIsNeg[0] ? minX : maxX), (r.dirIsNeg[1] ? minY : maxY), (r.dirIsNeg[2] ? minZ : maxZ) };
+#ifdef __SSE__
+        // [t0Lo, t0Hi]: entry distances ; [t1Lo, t1Hi]: exit distances
+        __m128 t0Lo = _mm_setzero_ps(), t0Hi = _mm_setzero_ps();
+        __m128 t1Lo = _mm_set1_ps(tMin), t1Hi = _mm_set1_ps(tMax);
+        const __m128 negInf = _mm_set1_ps(-INFINITY), posInf = _mm_set1_ps(INFINITY);
+        for (int a=0 ; a<3 ; a++) {
+            const __m128 oLo = _mm_set1_ps(p.oMin[a]), oHi = _mm_set1_ps(p.oMax[a]);
+            const __m128 iLo = _mm_set1_ps(p.iMin[a]), iHi = _mm_set1_ps(p.iMax[a]);
+            // (near - o) * invDir
+            const __m128 n0 = _mm_sub_ps(_mm_loadu_ps(nearA[a]), oHi);
+            const __m128 n1 = _mm_sub_ps(_mm_loadu_ps(nearA[a]), oLo);
+            const __m128 n00 = ifNaN(_mm_mul_ps(n0, iLo), negInf), n01 = ifNaN(_mm_mul_ps(n0, iHi), negInf);
+            const __m128 n10 = ifNaN(_mm_mul_ps(n1, iLo), negInf), n11 = ifNaN(_mm_mul_ps(n1, iHi), negInf);
+            t0Lo = _mm_max_ps(_mm_min_ps(_mm_min_ps(n00, n01), _mm_min_ps(n10, n11)), t0Lo);
+            t0Hi = _mm_max_ps(_mm_max_ps(_mm_max_ps(n00, n01), _mm_max_ps(n10, n11)), t0Hi);
+            // (far - o) * invDir
+            const __m128 f0 = _mm_sub_ps(_mm_loadu_ps(farA[a]), oHi);
+            const __m128 f1 = _mm_sub_ps(_mm_loadu_ps(farA[a]), oLo);
+            const __m128 f00 = ifNaN(_mm_mul_ps(f0, iLo), posInf), f01 = ifNaN(_mm_mul_ps(f0, iHi), posInf);
+            const __m128 f10 = ifNaN(_mm_mul_ps(f1, iLo), posInf), f11 = ifNaN(_mm_mul_ps(f1, iHi), posInf);
+            t1Lo = _mm_min_ps(_mm_min_ps(_mm_min_ps(f00, f01), _mm_min_ps(f10, f11)), t1Lo);
+            t1Hi = _mm_min_ps(_mm_max_ps(_mm_max_ps(f00, f01), _mm_max_ps(f10, f11)), t1Hi);
+        }
+        const __m128 gammaScale = _mm_set1_ps(1 + 2 * gamma(3));
+        _mm_storeu_ps(tNear, t0Lo);
+        *all = _mm_movemask_ps(_mm_cmple_ps(t0Hi, _mm_mul_ps(t1Lo, gammaScale)));
+        return _mm_movemask_ps(_mm_cmple_ps(t0Lo, _mm_mul_ps(t1Hi, gammaScale)));
+#else
+        int any = 0;
+        *all = 0;
+        for (int i=0 ; i<4 ; i++) {
+            float t0Lo = 0.f, t0Hi = 0.f, t1Lo = tMin, t1Hi = tMax;
+            for (int a=0 ; a<3 ; a++) {
+                const float n0 = nearA[a][i] - p.oMax[a], n1 = nearA[a][i] - p.oMin[a];
+                const float f0 = farA[a][i] - p.oMax[a], f1 = farA[a][i] - p.oMin[a];
+                const float n00 = ifNaN(n0 * p.iMin[a], -INFINITY), n01 = ifNaN(n0 * p.iMax[a], -INFINITY);
+                const float n10 = ifNaN(n1 * p.iMin[a], -INFINITY), n11 = ifNaN(n1 * p.iMax[a], -INFINITY);
+                const float f00 = ifNaN(f0 * p.iMin[a], INFINITY), f01 = ifNaN(f0 * p.iMax[a], INFINITY);
+                const float f10 = ifNaN(f1 * p.iMin[a], INFINITY), f11 = ifNaN(f1 * p.iMax[a], INFINITY);
+                t0Lo = fmaxf(t0Lo, fminf(fminf(n00, n01), fminf(n10, n11)));
+                t0Hi = fmaxf(t0Hi, fmaxf(fmaxf(n00, n01), fmaxf(n10, n11)));
+                t1Lo = fminf(t1Lo, fminf(fminf(f00, f01), fminf(f10, f11)));
+                t1Hi = fminf(t1Hi, fmaxf(fmaxf(f00, f01), fmaxf(f10, f11)));
+            }
+            tNear[i] = t0Lo;
+            *all |= (t0Hi <= t1Lo * (1 + 2 * gamma(3))) << i;
+            any |= (t0Lo <= t1Hi * (1 + 2 * gamma(3))) << i;
+        }
+        return any;
+#endif
+    }
+} BB4;
+
+#endif /* BB4_hpp */
@@ -26,7 +26,7 @@ public:
     RGB Ka, Kd, Ks, Kt;
 
     BRDF () {textured=false;}
-    ~BRDF () {}
+    virtual ~BRDF () {}
     // return the BRDF RGB value for a pair of (incident, scattering) directions : (wi,wo)
     virtual RGB f (Vector wi, Vector wo, const BRDF_TYPES = BRDF_ALL) {return RGB();}
     // return an outgoing direction wo and brdf RGB value for a given wi and probability pair prob[2]
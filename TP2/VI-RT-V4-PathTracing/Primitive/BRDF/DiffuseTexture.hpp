@@ -9,25 +9,24 @@
 #define DiffuseTexture_hpp
 
 #include "BRDF.hpp"
-#include "ImagePPM.hpp"
+#include "MipMap.hpp"
+#include "ImageCache.hpp"
 #include "triangle.hpp"
+#include <memory>
 
 class DiffuseTexture: public BRDF {
 private:
-    ImagePPM texture;
-    float tex_W, tex_H;
+    // shared with the other materials using the same file (see ImageCache)
+    std::shared_ptr<const MipMap> texture;
 public:
     DiffuseTexture(std::string filename) {
-        texture.Load(filename);
+        texture = ImageCache::Texture(filename);
         textured=true;
-        tex_W = float (texture.W);
-        tex_H = float (texture.H);
     }
-    RGB GetKd (Vec2 TexCoord) {
-        int x = (int)floor(TexCoord.u * tex_W);
-        int y = (int)floor(TexCoord.v * tex_H);
-
-        RGB color = Kd*texture.get(x, y);
+    // footprint: width of the ray's footprint on texture coordinates
+    // (see Intersection::TexFootprint) ; trilinear filtering
+    RGB GetKd (Vec2 TexCoord, float footprint=0.f) {
+        RGB color = Kd*texture->Lookup(TexCoord, footprint);
         return color;
     }
 };
@@ -6,6 +6,8 @@
 //
 
 #include <stdio.h>
+#include <math.h>
+#include <algorithm>
 #include "Sphere.hpp"
 
 bool Sphere::intersect(Ray r, Intersection *isect) {
@@ -13,47 +15,75 @@ bool Sphere::intersect(Ray r, Intersection *isect) {
     if (!bb.intersect(r)) {
         return false;
     }
-    
+    HitRecord h;
+    if (!hit(r, MAXFLOAT, &h)) {
+        return false;
+    }
+    finalize(r, h, isect);
+    return true;
+}
+
+bool Sphere::hit(const Ray &r, const float tMax, HitRecord *h) {
     // from https://raytracing.github.io/books/RayTracingInOneWeekend.html#surfacenormalsandmultipleobjects/simplifyingtheray-sphereintersectioncode
-    Vector oc = r.o.vec2point(C);
+    const Vector oc(C.X - r.o.X, C.Y - r.o.Y, C.Z - r.o.Z);
     //float a = r.dir.normSQ();
     //float a = 1.f;   // ray direction is normalized
-    float h = r.dir.dot(oc);
-    float c = oc.normSQ() - radiusSq;
-    float discriminant = h*h - c;
+    const float half_b = r.dir.dot(oc);
+    const float c = oc.normSQ() - radiusSq;
+    const float discriminant = half_b*half_b - c;
     if (discriminant < EPSILON) {
         return (false);
     }
     
     // intersection distance along ray
-    float t = h - std::sqrt(discriminant);
-    
-    if (t > EPSILON) // ray intersection
+    const float t = half_b - std::sqrt(discriminant);
+    if (t > EPSILON && t < tMax) // ray intersection
     {
-        Point pHit = r.o + t* r.dir;
-        Vector normal = C.vec2point(pHit);
-        normal.normalize();
-        
-        // Fill Intersection data from triangle hit : pag 165
-        Vector wo = -1.f * r.dir;
-        // make sure the normal points to the same side of the surface as wo
-        Vector const for_normal = normal.Faceforward(wo);
-        isect->p = pHit;
-        isect->gn = for_normal;
-        isect->sn = for_normal;
-        isect->wo = wo;
-        isect->depth = t;
-        isect->FaceID = -1;
-        isect->pix_x = r.pix_x;
-        isect->pix_y = r.pix_y;
-        isect->incident_eta = r.propagating_eta;
-        
+        h->t = t;
+        h->u = h->v = 0.f;
         return true;
     }
-    else  {// This means that there is a line intersection but not a ray intersection.
+    // This means that there is a line intersection but not a ray intersection.
+    return false;
+}
+
+void Sphere::finalize(const Ray &r, const HitRecord &h, Intersection *isect) {
+    Point pHit = r.o + h.t* r.dir;
+    Vector normal = C.vec2point(pHit);
+    normal.normalize();
+    
+    // Fill Intersection data from triangle hit : pag 165
+    Vector wo = -1.f * r.dir;
+    // make sure the normal points to the same side of the surface as wo
+    Vector const for_normal = normal.Faceforward(wo);
+    isect->p = pHit;
+    isect->gn = for_normal;
+    isect->sn = for_normal;
+    isect->wo = wo;
+    isect->depth = h.t;
+    isect->FaceID = -1;
+    isect->pix_x = r.pix_x;
+    isect->pix_y = r.pix_y;
+    isect->incident_eta = r.propagating_eta;
+    // spherical coordinates of the hit as texture coordinates
+    // pbrt 3rd edition, sec 3.2.2, pag 136 (pbrt.org)
+    const float phi = atan2f(normal.Y, normal.X);
+    isect->TexCoord.u = (phi < 0.f ? phi + 2.f * (float)M_PI : phi) / (2.f * (float)M_PI);
+    isect->TexCoord.v = acosf(std::min(std::max(normal.Z, -1.f), 1.f)) / (float)M_PI;
+    // the ray cone is not propagated over spheres: finest texture level
+    isect->TexFootprint = 0.f;
+}
+
+// distance only version of intersect(), used for shadow rays
+bool Sphere::occluded(const Ray &r, const float tMax) {
+    const Vector oc(C.X - r.o.X, C.Y - r.o.Y, C.Z - r.o.Z);
+    const float h = r.dir.dot(oc);
+    const float c = oc.normSQ() - radiusSq;
+    const float discriminant = h*h - c;
+    if (discriminant < EPSILON) {
         return false;
     }
-    
-    return false;
+    // nearest intersection distance along ray
+    const float t = h - std::sqrt(discriminant);
+    return (t > EPSILON && t < tMax);
 }
- 
@@ -17,11 +17,18 @@ public:
     Point C;
     float radius;
     float radiusSq;
-    BB bb;      // sphere bounding box
-                // this is min={0.,0.,0.} , max={0.,0.,0.} due to the Point constructor
     bool intersect (Ray r, Intersection *isect);
+    bool occluded (const Ray &r, const float tMax);
+    bool hit (const Ray &r, const float tMax, HitRecord *h);
+    void finalize (const Ray &r, const HitRecord &h, Intersection *isect);
     
-    Sphere(Point _C, float _r): C(_C), radius(_r) {
+    Sphere(Point _C, float _r) {
+        set(_C, _r);
+    }
+    // moves / resizes the sphere in place (e.g., across animation frames)
+    void set (Point _C, float _r) {
+        C = _C;
+        radius = _r;
         radiusSq = radius * radius;
         bb.min.set(C.X-radius, C.Y-radius, C.Z-radius);
         bb.max.set(C.X+radius, C.Y+radius, C.Z+radius);
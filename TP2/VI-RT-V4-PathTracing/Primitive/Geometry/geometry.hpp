@@ -26,7 +26,20 @@ public:
         }*/
         return false;
     }
-    // geometric primitive bounding box
+    // return True if r intersects this geometric primitive at a distance in ]EPSILON, tMax[
+    // only the distance is computed: used for shadow rays
+    virtual bool occluded (const Ray &r, const float tMax) {
+        return false;
+    }
+    // return True if r intersects this geometric primitive at a distance in ]EPSILON, tMax[
+    // only the distance and (u,v) are computed on h: see finalize()
+    virtual bool hit (const Ray &r, const float tMax, HitRecord *h) {
+        return false;
+    }
+    // compute the surface attributes on isect for a hit found by hit()
+    virtual void finalize (const Ray &r, const HitRecord &h, Intersection *isect) {
+    }
+    // geometric primitive bounding box (set by the derived class constructor)
     BB bb;  // this is min={0.,0.,0.} , max={0.,0.,0.} due to the Point constructor
 };
 
@@ -9,40 +9,6 @@
 #include "BB.hpp"
 
 
-// Function to compute barycentric coordinates
-Vector Triangle::computeBarycentrics (Point p) {
-    Vector bary;
-        //v0v1 = edge1
-        //v0v2 = edge2
-    Vector v1p  = v1.vec2point (p);
-    
-    float areaABC = area(); // Triangle area
-
-    // Compute lambda1
-    Vector v2p  = v2.vec2point(p);
-    Vector n1 = { edge3.Y * v2p.Z - edge3.Z * v2p.Y,
-        edge3.Z * v2p.X - edge3.X * v2p.Z,
-        edge3.X * v2p.Y - edge3.Y * v2p.X };
-
-    float areaPBC = n1.norm() / 2.0f;
-    bary.X = areaPBC / areaABC;
-
-    // Compute lambda2
-    Vector v3v1 = -1.f * edge2;
-    Vector v3p  = v3.vec2point(p);
-    Vector n2 = { v3v1.Y * v3p.Z - v3v1.Z * v3p.Y,
-        v3v1.Z * v3p.X - v3v1.X * v3p.Z,
-        v3v1.X * v3p.Y - v3v1.Y * v3p.X };
-
-    float areaPCA = n2.norm() / 2.0f;
-    bary.Y = areaPCA / areaABC;
-
-    // Compute lambda3
-    bary.Z = 1.0f - bary.X - bary.Y;
-    
-    return bary;
-}
-
 // Function to map texture coordinates using barycentric coordinates
 Vec2 Triangle::interpolateTexture(Vector baryCoord) {
     Vec2 uv;
@@ -57,7 +23,16 @@ bool Triangle::intersect(Ray r, Intersection *isect) {
     if (!bb.intersect(r)) {
         return false;
     }
+    HitRecord h;
+    if (!hit(r, MAXFLOAT, &h)) {
+        return false;
+    }
+    finalize(r, h, isect);
+    return true;
+}
 
+// the bounding box test is left to the caller (the BVH)
+bool Triangle::hit(const Ray &r, const float tMax, HitRecord *h) {
     // Check whether the ray is parallel to the plan containing the triangle
     // The dot ptoduct between the ray direction and the triangle normal will be 0
     
@@ -71,50 +46,88 @@ bool Triangle::intersect(Ray r, Intersection *isect) {
     // there are 3 unknowns (t,u,v)
     // and 3 equations (for XX, YY, ZZ)
     
-    Vector h, s, q;
-    float a,ff,u,v;
-
-    h = r.dir.cross(edge2);
-    a = edge1.dot(h);
-    ff = 1.0/a;
-    s = v1.vec2point(r.o);
-    u = ff * s.dot(h);
-    if (u < 0.0 || u > 1.0) {
+    const Vector pvec = r.dir.cross(edge2);
+    const float ff = 1.0f / edge1.dot(pvec);
+    const Vector s = v1.vec2point(r.o);
+    const float u = ff * s.dot(pvec);
+    if (u < 0.0f || u > 1.0f) {
         return false;
     }
-    q = s.cross(edge1);
-    v = ff * r.dir.dot(q);
-    if (v < 0.0 || u + v > 1.0) {
+    const Vector q = s.cross(edge1);
+    const float v = ff * r.dir.dot(q);
+    if (v < 0.0f || u + v > 1.0f) {
         return false;
     }
     // At this stage we can compute t to find out where the intersection point is on the line.
-    float t = ff * edge2.dot(q);
-    if (t > EPSILON) // ray intersection
+    const float t = ff * edge2.dot(q);
+    if (t > EPSILON && t < tMax) // ray intersection
     {
-        Point pHit = r.o + t* r.dir;
-        
-        // Fill Intersection data from triangle hit : pag 165
-        Vector wo = -1. * r.dir;
-        // make sure the normal points to the same side of the surface as wo
-        Vector const for_normal = normal.Faceforward(wo);
-        isect->p = pHit;
-        isect->gn = for_normal;
-        isect->sn = for_normal;
-        isect->wo = wo;
-        isect->depth = t;
-        isect->FaceID = -1;
-        isect->pix_x = r.pix_x;
-        isect->pix_y = r.pix_y;
-        isect->incident_eta = r.propagating_eta;
-        
-        Vector baryCoord = computeBarycentrics(pHit);
-        isect->TexCoord = interpolateTexture(baryCoord);
-
+        h->t = t;
+        h->u = u;
+        h->v = v;
         return true;
     }
-    else  {// This means that there is a line intersection but not a ray intersection.
+    // This means that there is a line intersection but not a ray intersection.
+    return false;
+}
+
+// Fill Intersection data from triangle hit : pag 165
+// (u,v) are the barycentric coordinates of v2 and v3
+void Triangle::finalize (const Ray &r, const HitRecord &h, Intersection *isect) {
+    Point pHit = r.o + h.t* r.dir;
+
+    Vector wo = -1. * r.dir;
+    // make sure the normal points to the same side of the surface as wo
+    Vector const for_normal = normal.Faceforward(wo);
+    isect->p = pHit;
+    isect->gn = for_normal;
+    isect->sn = for_normal;
+    isect->wo = wo;
+    isect->depth = h.t;
+    isect->FaceID = -1;
+    isect->pix_x = r.pix_x;
+    isect->pix_y = r.pix_y;
+    isect->incident_eta = r.propagating_eta;
+
+    isect->TexCoord = interpolateTexture(Vector(1.f - h.u - h.v, h.u, h.v));
+
+    // the width of the ray cone at the hit, projected on the triangle and
+    // scaled by the ratio of the texture to the world areas
+    // Akenine-Moller et al., "Texture Level of Detail Strategies for
+    // Real-Time Ray Tracing", Ray Tracing Gems, ch. 20, 2019
+    isect->TexFootprint = 0.f;
+    if (r.coneSpread > 0.f) {
+        const float cosTheta = std::abs(normal.dot(r.dir));
+        const float uvArea = std::abs((uv2.u - uv1.u) * (uv3.v - uv1.v) - (uv3.u - uv1.u) * (uv2.v - uv1.v));
+        const float worldArea = edge1.cross(edge2).norm();
+        if (cosTheta > 0.f && worldArea > 0.f) {
+            isect->TexFootprint = h.t * r.coneSpread / cosTheta * sqrtf(uvArea / worldArea);
+        }
+    }
+}
+
+// Moller Trumbore, computing only the distance along the ray
+// the bounding box test is left to the caller (the BVH)
+bool Triangle::occluded(const Ray &r, const float tMax) {
+    const float par = normal.dot(r.dir);
+    if ((BackFaceCulling && par > -EPSILON) || (!BackFaceCulling && std::abs(par) < EPSILON)) {
+        return false;    // This ray is parallel to this triangle.
+    }
+
+    const Vector h = r.dir.cross(edge2);
+    const float ff = 1.0f / edge1.dot(h);
+    const Vector s = v1.vec2point(r.o);
+    const float u = ff * s.dot(h);
+    if (u < 0.0f || u > 1.0f) {
+        return false;
+    }
+    const Vector q = s.cross(edge1);
+    const float v = ff * r.dir.dot(q);
+    if (v < 0.0f || u + v > 1.0f) {
         return false;
     }
+    const float t = ff * edge2.dot(q);
+    return (t > EPSILON && t < tMax);
 }
 
 bool Triangle::isInside(Point p) {
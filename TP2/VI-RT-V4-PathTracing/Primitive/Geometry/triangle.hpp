@@ -13,7 +13,6 @@
 #include <math.h>
 
 class Triangle: public Geometry {
-    Vector computeBarycentrics (Point p);
     Vec2 interpolateTexture(Vector baryCoord);
 public:
     bool BackFaceCulling;
@@ -21,9 +20,10 @@ public:
     Vec2 uv1, uv2, uv3;  // texture coordinates for each vertex
     Vector normal;           // geometric normal
     Vector edge1, edge2, edge3;
-    BB bb;      // face bounding box
-                // this is min={0.,0.,0.} , max={0.,0.,0.} due to the Point constructor
     bool intersect (Ray r, Intersection *isect);
+    bool occluded (const Ray &r, const float tMax);
+    bool hit (const Ray &r, const float tMax, HitRecord *h);
+    void finalize (const Ray &r, const HitRecord &h, Intersection *isect);
     bool isInside(Point p);
     
     Triangle(Point _v1, Point _v2, Point _v3, Vector _normal, bool backface=true): v1(_v1), v2(_v2), v3(_v3), normal(_normal) {
@@ -52,6 +52,23 @@ public:
         bb.update(v3);
     }
     
+    // moves the triangle in place (e.g., across animation frames)
+    // the normal keeps its orientation relative to the previous one,
+    // such that explicitly given normals (area lights) are preserved
+    void setVertices (Point _v1, Point _v2, Point _v3) {
+        v1 = _v1; v2 = _v2; v3 = _v3;
+        edge1 = v1.vec2point(v2);
+        edge2 = v1.vec2point(v3);
+        edge3 = v2.vec2point(v3);
+        Vector n = edge1.cross(edge2);
+        n.normalize();
+        normal = (n.dot(normal) < 0.f ? -n : n);
+        bb.min.set(v1.X, v1.Y, v1.Z);
+        bb.max.set(v1.X, v1.Y, v1.Z);
+        bb.update(v2);
+        bb.update(v3);
+    }
+    
     void set_uv (Vec2 _uv1,Vec2 _uv2,Vec2 _uv3) {
         uv1=_uv1;
         uv2=_uv2;
@@ -0,0 +1,56 @@
+//
+//  RayPacket.hpp
+//  VI-RT-V4-PathTracing
+//
+//  a group of up to 64 coherent rays (e.g., the primary rays of an 8x8 block
+//  of pixels) traced together through the BVH (see BVH::IntersectPacket())
+//  the packet is bounded by the intervals of its origins and of its
+//  direction reciprocals, such that a box can be culled for all the rays at
+//  once with interval arithmetic
+//  Boulos et al., "Geometric and Arithmetic Culling Methods for Entire Ray
+//  Packets", Tech. Rep. UUCS-06-010, University of Utah, 2006
+//
+
+#ifndef RayPacket_hpp
+#define RayPacket_hpp
+
+#include "ray.hpp"
+#include <math.h>
+#include <stdint.h>
+
+typedef struct RayPacket {
+    static const int maxSize = 64;   // one bit per ray on an uint64_t mask
+    int size;
+    Ray r[maxSize];
+    // bounds of the packet (set by ComputeBounds())
+    float oMin[3], oMax[3];          // origins
+    float iMin[3], iMax[3];          // direction reciprocals (Ray::invDir)
+    bool coherent;   // all the rays have the same direction signs: the bounds can be used
+
+    RayPacket (): size(0), coherent(false) {}
+
+    // to be called after the rays are set up (Ray::invertDir() included)
+    void ComputeBounds (void) {
+        coherent = (size > 0);
+        for (int a=0 ; a<3 ; a++) {
+            oMin[a] = iMin[a] = INFINITY;
+            oMax[a] = iMax[a] = -INFINITY;
+        }
+        for (int k=0 ; k<size ; k++) {
+            const Ray &ray = r[k];
+            const float o[3] = { ray.o.X, ray.o.Y, ray.o.Z };
+            const float i[3] = { ray.invDir.X, ray.invDir.Y, ray.invDir.Z };
+            for (int a=0 ; a<3 ; a++) {
+                oMin[a] = fminf(oMin[a], o[a]); oMax[a] = fmaxf(oMax[a], o[a]);
+                iMin[a] = fminf(iMin[a], i[a]); iMax[a] = fmaxf(iMax[a], i[a]);
+                // an interval spanning 0 would include the infinite reciprocals
+                if (ray.dirIsNeg[a] != r[0].dirIsNeg[a]) coherent = false;
+            }
+        }
+    }
+    uint64_t allRays (void) const {
+        return (size >= 64 ? ~(uint64_t)0 : (((uint64_t)1 << size) - 1));
+    }
+} RayPacket;
+
+#endif /* RayPacket_hpp */
@@ -25,8 +25,10 @@ public:
     int FaceID;  // ID of the intersected face 
     bool isLight;  // for intersections with light sources
     RGB Le;         // for intersections with light sources
+    int lightNdx;   // for intersections with light sources: index on Scene::lights
     float incident_eta;
     Vec2 TexCoord;    
+    float TexFootprint;   // width of the ray's footprint on texture coordinates (see Ray::coneSpread)
     
     Intersection() {}
     // from pbrt book, section 2.10, pag 116
@@ -34,4 +36,13 @@ public:
     : p(p), gn(n), sn(n), wo(wo), depth(depth), f(NULL) { }
 } Intersection;
 
+// candidate intersection: only the distance and the parametric coordinates
+// the surface attributes (Intersection) are computed for the closest
+// candidate only, with Geometry::finalize()
+typedef struct HitRecord {
+    float t;      // distance along the ray
+    int item;     // intersected object (index on BVH::items)
+    float u, v;   // barycentric coordinates of v2 and v3 (triangles)
+} HitRecord;
+
 #endif /* Intersection_hpp */
@@ -26,22 +26,33 @@ public:
     Vector dir; // ray direction
     int FaceID;  // ID of the face where the origin lays in
     Vector invDir;  // ray direction reciprocal for intersections
+    int dirIsNeg[3];  // 1 if the corresponding invDir component is negative
     RGB throughput;
     int pix_x, pix_y;
     float propagating_eta;
-    Ray () {}
-    Ray (Point o, Vector d, RayType t, RGB _throughput): o(o),dir(d), rtype(t), throughput(_throughput) {
-        //invertDir();
-    }
-    Ray (Point o, Vector d, RayType t): o(o),dir(d), rtype(t) {
-        Ray (o, d, t, RGB(1.0, 1.0, 1.0));
+    // the ray is the axis of a cone of this angle (radians), the footprint
+    // of a pixel, for texture filtering ; 0: a thin ray (the finest texture level)
+    // set by the camera for the primary rays only
+    float coneSpread;
+    Ray (): coneSpread(0.f) {}
+    Ray (Point o, Vector d, RayType t, RGB _throughput): o(o),dir(d), rtype(t), throughput(_throughput), coneSpread(0.f) {
+        invertDir();
     }
+    Ray (Point o, Vector d, RayType t): Ray (o, d, t, RGB(1.0, 1.0, 1.0)) {}
     ~Ray() {}
 
+    // must be called whenever dir is changed
+    // (the constructors and Camera::GenerateRay() do it)
+    // a null component has an infinite reciprocal, with the sign of the zero
+    // (pbrt 3rd edition, sec 3.1.2): the ray never leaves the slab it starts in
+    // the slab tests must ignore the NaN of 0 * inf (see BB::IntersectP())
     void invertDir (void) {
-        invDir.X = (dir.X!=0.f ? 1.f / dir.X : 1.e5);
-        invDir.Y = (dir.Y!=0.f ? 1.f / dir.Y : 1.e5);
-        invDir.Z = (dir.Z!=0.f ? 1.f / dir.Z : 1.e5);
+        invDir.X = 1.f / dir.X;
+        invDir.Y = 1.f / dir.Y;
+        invDir.Z = 1.f / dir.Z;
+        dirIsNeg[0] = (invDir.X < 0.f);
+        dirIsNeg[1] = (invDir.Y < 0.f);
+        dirIsNeg[2] = (invDir.Z < 0.f);
     }
 
     void adjustOrigin (Vector normal) {
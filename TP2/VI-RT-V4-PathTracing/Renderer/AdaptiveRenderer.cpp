@@ -0,0 +1,71 @@
+//
+//  AdaptiveRenderer.cpp
+//  VI-RT-V4-PathTracing
+//
+
+#include "AdaptiveRenderer.hpp"
+#include <fstream>
+#include <algorithm>
+
+bool AdaptiveRenderer::PreparePass (void) {
+    const int N = W*H;
+    long long used = 0;
+
+    passSamples.resize(N);
+    for (int i = 0; i < N; i++) used += stats[i].n;
+    long long remaining = (long long)(avgSpp * N) - used;
+    if (remaining <= 0) return false;
+
+    // base pass
+    if (used == 0) {
+        for (int i = 0; i < N; i++) passSamples[i] = baseSpp;
+        return true;
+    }
+
+    // this pass' budget is sppPerPass samples per pixel on average,
+    // distributed proportionally to the pixels relative error
+    std::vector<float> err(N);
+    double sumErr = 0.;
+    for (int i = 0; i < N; i++) {
+        err[i] = (Converged(stats[i]) ? 0.f : Error(stats[i]));
+        sumErr += err[i];
+    }
+    if (sumErr <= 0.) return false;   // all pixels converged
+
+    const long long budget = std::min(remaining, (long long)sppPerPass * N);
+    // the fractional parts are carried to the next pixel (error diffusion),
+    // such that the total is preserved and the allocation is deterministic
+    double carry = 0.;
+    int allocated = 0;
+    for (int i = 0; i < N; i++) {
+        const double want = budget * err[i] / sumErr + carry;
+        int n = (int)want;
+        carry = want - n;
+        if (n > spp - stats[i].n) n = spp - stats[i].n;
+        passSamples[i] = n;
+        allocated += n;
+    }
+    // if the error is very concentrated all the pixels may be capped by spp
+    return (allocated > 0);
+}
+
+bool AdaptiveRenderer::SaveSampleMap (const std::string &filename) {
+    std::ofstream ofs(filename, std::ios::binary);
+    if (ofs.fail()) return false;
+
+    int maxN = 1;
+    for (auto &p : stats) if (p.n > maxN) maxN = p.n;
+
+    ofs << "P6\n" << W << " " << H << "\n255\n";
+    for (auto &p : stats) {
+        // 3 segments: black -> red, red -> yellow, yellow -> white
+        const float v = 3.f * p.n / maxN;
+        const float r = (v < 1.f ? v : 1.f);
+        const float g = (v < 1.f ? 0.f : (v < 2.f ? v - 1.f : 1.f));
+        const float b = (v < 2.f ? 0.f : v - 2.f);
+        const unsigned char rgb[3] = {(unsigned char)(255.f * r), (unsigned char)(255.f * g), (unsigned char)(255.f * b)};
+        ofs.write((const char *)rgb, 3);
+    }
+    ofs.close();
+    return true;
+}
@@ -0,0 +1,37 @@
+//
+//  AdaptiveRenderer.hpp
+//  VI-RT-V4-PathTracing
+//
+//  progressive renderer that distributes a total sample budget
+//  according to the per pixel error estimates:
+//  after a base pass with the same number of samples for all pixels,
+//  each pass gives more samples to the pixels with larger relative error
+//
+
+#ifndef AdaptiveRenderer_hpp
+#define AdaptiveRenderer_hpp
+
+#include "ProgressiveRenderer.hpp"
+
+class AdaptiveRenderer: public ProgressiveRenderer {
+    float avgSpp;             // total budget is avgSpp * W * H samples
+    int baseSpp;              // samples per pixel on the base pass
+    std::vector<int> passSamples;   // samples per pixel on the current pass
+
+    bool PreparePass (void);
+    int SamplesThisPass (const int x, const int y) { return passSamples[y*W + x]; }
+public:
+    // _maxSpp limits the number of samples of any pixel
+    AdaptiveRenderer (Camera *cam, Scene * scene, Image * img, Shader *shd, float _avgSpp, int _maxSpp,
+                      float _errorThreshold, float _timeBudget=0.f, bool _jitter=true, uint64_t _seed=0,
+                      int _baseSpp=8):
+        ProgressiveRenderer(cam, scene, img, shd, _maxSpp, _timeBudget, _errorThreshold, _jitter, _seed),
+        avgSpp(_avgSpp), baseSpp(_baseSpp) {
+        minSpp = baseSpp;
+    }
+    // writes the number of samples of each pixel as a heat map (binary PPM)
+    // black (no samples) -> red -> yellow -> white (the most sampled pixel)
+    bool SaveSampleMap (const std::string &filename);
+};
+
+#endif /* AdaptiveRenderer_hpp */
@@ -10,6 +10,7 @@
 void DummyRenderer::Render () {
     int W=0,H=0;  // resolution
     int x,y;
+    Sampler sampler;
 
     // get resolution from the camera
     cam->getResolution(&W, &H);
@@ -23,7 +24,8 @@ void DummyRenderer::Render () {
             RGB color;
           
             // Generate Ray (camera)
-            cam->GenerateRay(x, y, &primary);
+            sampler.StartPixelSample(x, y, 0);
+            cam->GenerateRay(x, y, &primary, sampler);
             
             // trace ray (scene)
             // we have no scene
@@ -33,7 +35,7 @@ void DummyRenderer::Render () {
             
             
             // shade this pixel (shader)
-            color = shd->shade(true, isect, 0);
+            color = shd->shade(true, isect, 0, sampler);
             
             // write the result into the image frame buffer (image)
             img->set(x,y,color);
@@ -0,0 +1,78 @@
+//
+//  FramePipeline.cpp
+//  VI-RT-V4-PathTracing
+//
+
+#include "FramePipeline.hpp"
+#include <omp.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+
+// the stage each frame has completed
+typedef enum {
+    FRAME_NONE,
+    FRAME_BUILT,
+    FRAME_RENDERED,
+    FRAME_SAVED
+} FrameState;
+
+void FramePipeline::Run (Stage Build, Stage Render, Stage Save) {
+    const int nSlots = numSlots();
+    std::vector<FrameState> state(nFrames, FRAME_NONE);
+    std::mutex mtx;
+    std::condition_variable changed;
+
+    auto waitFor = [&](const int frame, const FrameState s) {
+        std::unique_lock<std::mutex> lock(mtx);
+        changed.wait(lock, [&]() { return state[frame] >= s; });
+    };
+    auto setState = [&](const int frame, const FrameState s) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            state[frame] = s;
+        }
+        changed.notify_all();
+    };
+
+    // a slot is free once the frame that last used it has been saved
+    std::thread builder([&]() {
+        for (int f = 0; f < nFrames; f++) {
+            if (f >= nSlots) waitFor(f - nSlots, FRAME_SAVED);
+            Build(f, f % nSlots);
+            setState(f, FRAME_BUILT);
+        }
+    });
+
+    std::thread saver([&]() {
+        for (int f = 0; f < nFrames; f++) {
+            waitFor(f, FRAME_RENDERED);
+            Save(f, f % nSlots);
+            setState(f, FRAME_SAVED);
+        }
+    });
+
+    // the frames are handed out in order to the rendering threads,
+    // each running its renderer's OpenMP loops with its share of the threads
+    std::atomic<int> nextFrame(0);
+    const int maxThreads = omp_get_max_threads();
+    const int nRenderers = (framesInFlight < nFrames ? framesInFlight : nFrames);
+    std::vector<std::thread> renderers;
+    for (int r = 0; r < nRenderers; r++) {
+        const int nThreads = maxThreads / nRenderers + (r < maxThreads % nRenderers ? 1 : 0);
+        renderers.push_back(std::thread([&, nThreads]() {
+            omp_set_num_threads(nThreads > 0 ? nThreads : 1);
+            for (int f = nextFrame++; f < nFrames; f = nextFrame++) {
+                waitFor(f, FRAME_BUILT);
+                Render(f, f % nSlots);
+                setState(f, FRAME_RENDERED);
+            }
+        }));
+    }
+
+    for (auto &t : renderers) t.join();
+    builder.join();
+    saver.join();
+}
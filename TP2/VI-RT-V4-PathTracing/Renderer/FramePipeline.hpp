@@ -0,0 +1,40 @@
+//
+//  FramePipeline.hpp
+//  VI-RT-V4-PathTracing
+//
+//  renders the frames of an animation as a 3 stage pipeline:
+//  while frame i is being rendered, frame i+1 is built (its scene is brought
+//  to that frame) by a builder thread and frame i-1 is saved by a saver thread
+//  up to framesInFlight frames are rendered at the same time, each with
+//  an equal share of the OpenMP threads, for frames too small to keep all
+//  the cores busy on their own
+//
+//  each frame uses one of numSlots() slots (frame % numSlots()) ; a slot holds
+//  whatever the stages need for one frame (typically a scene and an image),
+//  owned by the caller: a slot is reused only after its previous frame was saved
+//
+
+#ifndef FramePipeline_hpp
+#define FramePipeline_hpp
+
+#include <functional>
+
+class FramePipeline {
+    int nFrames;
+    int framesInFlight;
+public:
+    // each stage is called with the frame and its slot
+    // Build is called in frame order, from a single thread
+    // Save is called in frame order, from a single thread
+    // Render may be called for framesInFlight frames at the same time
+    typedef std::function<void (const int frame, const int slot)> Stage;
+
+    FramePipeline (const int _nFrames, const int _framesInFlight=1):
+        nFrames(_nFrames), framesInFlight(_framesInFlight < 1 ? 1 : _framesInFlight) {}
+    // the frames being rendered, plus the one being built and the one being saved
+    int numSlots (void) const { return framesInFlight + 2; }
+    // returns once all frames are saved
+    void Run (Stage Build, Stage Render, Stage Save);
+};
+
+#endif /* FramePipeline_hpp */
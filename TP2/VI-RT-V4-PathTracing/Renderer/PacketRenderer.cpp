@@ -0,0 +1,44 @@
+//
+//  PacketRenderer.cpp
+//  VI-RT-V4-PathTracing
+//
+
+#include "PacketRenderer.hpp"
+#include <vector>
+
+// the samples of each pixel are added in the same order as StandardRenderer::RenderTile()
+void PacketRenderer::RenderTile (const Tile &t, Sampler &sampler, RGB *tileBuffer) {
+    float const sppf = 1.f / spp;
+    const int tW = t.x1 - t.x0;
+    const int tH = t.y1 - t.y0;
+    // each ray of the packet continues its own random stream while shaded
+    std::vector<Sampler> samplers(packetSize * packetSize, sampler);
+    std::vector<Intersection> isect(packetSize * packetSize);
+    bool intersected[RayPacket::maxSize];
+    RayPacket p;
+
+    for (int i = 0; i < tW * tH; i++) tileBuffer[i] = RGB(0., 0., 0.);
+
+    for (int by = t.y0; by < t.y1; by += packetSize) {
+        for (int bx = t.x0; bx < t.x1; bx += packetSize) {
+            const int bx1 = (bx + packetSize < t.x1 ? bx + packetSize : t.x1);
+            const int by1 = (by + packetSize < t.y1 ? by + packetSize : t.y1);
+            for (int s = 0; s < spp; s++) {
+                p.size = 0;
+                for (int y = by; y < by1; y++) {
+                    for (int x = bx; x < bx1; x++) {
+                        GeneratePrimary(x, y, s, samplers[p.size], &p.r[p.size]);
+                        p.size++;
+                    }
+                }
+                p.ComputeBounds();
+                scene->tracePacket(p, isect.data(), intersected);
+                for (int k = 0; k < p.size; k++) {
+                    const Ray &r = p.r[k];
+                    tileBuffer[(r.pix_y - t.y0) * tW + (r.pix_x - t.x0)] += ShadePrimary(intersected[k], isect[k], r, samplers[k]);
+                }
+            }
+        }
+    }
+    for (int i = 0; i < tW * tH; i++) tileBuffer[i] = tileBuffer[i] * sppf;
+}
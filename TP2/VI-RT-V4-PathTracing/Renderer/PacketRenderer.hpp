@@ -0,0 +1,29 @@
+//
+//  PacketRenderer.hpp
+//  VI-RT-V4-PathTracing
+//
+//  StandardRenderer with the primary rays traced in packets: for each
+//  sample, the rays of a packetSize x packetSize block of pixels of the tile
+//  share the BVH traversal (see Scene::tracePacket()) ; the secondary rays
+//  spawned by the shader are traced one at a time as before
+//  the random streams are those of StandardRenderer, hence so is the image
+//
+
+#ifndef PacketRenderer_hpp
+#define PacketRenderer_hpp
+
+#include "StandardRenderer.hpp"
+#include "RayPacket.hpp"
+
+class PacketRenderer: public StandardRenderer {
+    int packetSize;   // 4 or 8 (packetSize^2 <= RayPacket::maxSize)
+protected:
+    void RenderTile (const Tile &t, Sampler &sampler, RGB *tileBuffer);
+public:
+    PacketRenderer (Camera *cam, Scene * scene, Image * img, Shader *shd, int _spp, bool _jitter=true, uint64_t _seed=0, int _tileSize=16, int _packetSize=8):
+        StandardRenderer(cam, scene, img, shd, _spp, _jitter, _seed, _tileSize) {
+        packetSize = (_packetSize < 1 ? 1 : (_packetSize > 8 ? 8 : _packetSize));
+    }
+};
+
+#endif /* PacketRenderer_hpp */
@@ -0,0 +1,96 @@
+//
+//  ProgressiveRenderer.cpp
+//  VI-RT-V4-PathTracing
+//
+
+#include "ProgressiveRenderer.hpp"
+#include "TileScheduler.hpp"
+#include <omp.h>
+#include <chrono>
+
+// luminance below which pixels are considered dark for the relative error
+#define MIN_Y 0.01f
+
+float ProgressiveRenderer::Error (const PixelStats &p) const {
+    return p.RelativeError(MIN_Y);
+}
+
+// true if pixel p requires no more samples
+bool ProgressiveRenderer::Converged (const PixelStats &p) const {
+    if (p.n >= spp) return true;
+    if (errorThreshold <= 0.f || p.n < minSpp) return false;
+    return Error(p) <= errorThreshold;
+}
+
+bool ProgressiveRenderer::AddSamples (const int x, const int y, const int n, Sampler &sampler) {
+    PixelStats &p = stats[y*W + x];
+    for (int i = 0; i < n && p.n < spp; i++) {
+        // samples are numbered across passes, hence the result does not depend on sppPerPass
+        p.add(SamplePixel(x, y, p.n, sampler));
+    }
+    return Converged(p);
+}
+
+int ProgressiveRenderer::RenderPass (void) {
+    TileScheduler scheduler(W, H, tileSize);
+    scheduler.Start(omp_get_max_threads());
+    int notConverged = 0;
+
+    #pragma omp parallel reduction(+:notConverged)
+    {
+        const int thread = omp_get_thread_num();
+        Sampler sampler(seed);
+        std::vector<RGB> tileBuffer(tileSize * tileSize);
+        Tile t;
+
+        while (scheduler.NextTile(thread, &t)) {
+            const int tW = t.x1 - t.x0;
+            for (int y = t.y0; y < t.y1; y++) {
+                for (int x = t.x0; x < t.x1; x++) {
+                    const int n = SamplesThisPass(x, y);
+                    if (n > 0) AddSamples(x, y, n, sampler);
+                    if (!Converged(stats[y*W + x])) notConverged++;
+                    tileBuffer[(y - t.y0) * tW + (x - t.x0)] = stats[y*W + x].mean;
+                }
+            }
+            // the image always holds the current estimate
+            img->setBlock(t.x0, t.y0, tW, t.y1 - t.y0, tileBuffer.data());
+            scheduler.TileDone();
+        }
+    }
+    return notConverged;
+}
+
+void ProgressiveRenderer::Render () {
+    using namespace std::chrono;
+
+    cam->getResolution(&W, &H);
+    eshd = dynamic_cast<EnvironmentShader*>(shd);
+    if ((int)stats.size() != W*H) {
+        stats.resize(W*H);
+        for (auto &p : stats) p.reset();
+        numPasses = 0;
+    }
+
+    const auto start = steady_clock::now();
+    double elapsed = 0., lastPass = 0.;
+    int notConverged = W*H;
+    while (notConverged > 0) {
+        // do not start a pass that is expected to exceed the time budget
+        if (timeBudget > 0.f && numPasses > 0 && elapsed + lastPass > timeBudget) break;
+        if (!PreparePass()) break;
+
+        notConverged = RenderPass();
+        numPasses++;
+
+        const double now = duration<double>(steady_clock::now() - start).count();
+        lastPass = now - elapsed;
+        elapsed = now;
+        fprintf(stderr, "pass %d: %.2f s, %d pixels not converged\r", numPasses, elapsed, notConverged);
+
+        if (saveEvery > 0 && numPasses % saveEvery == 0) {
+            img->Save(intermediatePrefix + std::to_string(numPasses) + ".ppm");
+        }
+    }
+    fprintf(stderr, "\n");
+}
@@ -0,0 +1,99 @@
+//
+//  ProgressiveRenderer.hpp
+//  VI-RT-V4-PathTracing
+//
+//  renders in passes of a few samples per pixel, accumulated in a
+//  persistent buffer, until a time budget is exhausted, the per pixel
+//  estimates converge or a maximum number of samples is reached
+//
+
+#ifndef ProgressiveRenderer_hpp
+#define ProgressiveRenderer_hpp
+
+#include "StandardRenderer.hpp"
+#include <vector>
+#include <string>
+#include <math.h>
+
+// running estimates of a pixel
+// the variance is computed on the luminance with Welford's online algorithm
+// https://en.wikipedia.org/wiki/Algorithms_for_calculating_variance#Welford's_online_algorithm
+typedef struct PixelStats {
+    RGB mean;
+    float meanY;   // luminance mean
+    float M2;      // sum of squared differences from the luminance mean
+    int n;         // number of samples
+
+    void reset (void) {
+        mean = RGB();
+        meanY = M2 = 0.f;
+        n = 0;
+    }
+    void add (const RGB &c) {
+        n++;
+        const float invN = 1.f / n;
+        mean.R += (c.R - mean.R) * invN;
+        mean.G += (c.G - mean.G) * invN;
+        mean.B += (c.B - mean.B) * invN;
+        const float Y = c.Y();
+        const float delta = Y - meanY;
+        meanY += delta * invN;
+        M2 += delta * (Y - meanY);
+    }
+    // sample variance of the luminance
+    float Variance (void) const {
+        return (n > 1 ? M2 / (n - 1) : 0.f);
+    }
+    // standard error of meanY relative to meanY
+    // minY avoids requiring an absurd number of samples on dark pixels
+    float RelativeError (const float minY) const {
+        return sqrtf(Variance() / n) / (meanY > minY ? meanY : minY);
+    }
+} PixelStats;
+
+class ProgressiveRenderer: public StandardRenderer {
+protected:
+    int sppPerPass;
+    float timeBudget;       // seconds ; <= 0 means no time limit
+    float errorThreshold;   // relative standard error ; <= 0 means no convergence test
+    int minSpp;             // minimum number of samples before testing convergence
+    std::string intermediatePrefix;   // write <prefix><pass>.ppm ...
+    int saveEvery;                    // ... every saveEvery passes ; 0 to disable
+    int W, H;
+    std::vector<PixelStats> stats;    // persistent accumulation buffer
+    int numPasses;
+
+    // adds up to n samples to pixel (x,y) ; returns Converged()
+    bool AddSamples (const int x, const int y, const int n, Sampler &sampler);
+    bool Converged (const PixelStats &p) const;
+    // relative standard error of p's estimate
+    float Error (const PixelStats &p) const;
+    // called before each pass ; returns false if there is no more work to do
+    virtual bool PreparePass (void) { return true; }
+    // number of samples to add to pixel (x,y) on this pass
+    virtual int SamplesThisPass (const int x, const int y) {
+        return (Converged(stats[y*W + x]) ? 0 : sppPerPass);
+    }
+    // renders one pass over all the image ; returns the number of pixels not converged
+    int RenderPass (void);
+public:
+    // _spp is the maximum number of samples per pixel
+    ProgressiveRenderer (Camera *cam, Scene * scene, Image * img, Shader *shd, int _spp,
+                         float _timeBudget, float _errorThreshold, bool _jitter=true, uint64_t _seed=0,
+                         int _sppPerPass=1):
+        StandardRenderer(cam, scene, img, shd, _spp, _jitter, _seed),
+        sppPerPass(_sppPerPass), timeBudget(_timeBudget), errorThreshold(_errorThreshold),
+        minSpp(8), saveEvery(0), W(0), H(0), numPasses(0) {}
+    // write the current estimate to disk every n passes (img->Save())
+    void SaveIntermediate (const std::string &prefix, const int n) {
+        intermediatePrefix = prefix;
+        saveEvery = n;
+    }
+    // discard the accumulated samples (e.g., if the scene or camera changed)
+    void Reset (void) { stats.clear(); numPasses = 0; }
+    // renders passes on top of the samples accumulated so far
+    void Render ();
+    int Passes (void) const { return numPasses; }
+};
+
+#endif /* ProgressiveRenderer_hpp */
@@ -6,58 +6,144 @@
 //
 
 #include "StandardRenderer.hpp"
-#include <random>
+#include "DiffuseTexture.hpp"
+#include <algorithm>
 #include <omp.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <vector>
 
-void StandardRenderer::Render () {
-    int W = 0, H = 0;  // resolução
-    int x, y, s;
+void StandardRenderer::GeneratePrimary (const int x, const int y, const int s, Sampler &sampler, Ray *primary) {
+    float jitterV[2];
 
-    std::random_device rdev{};
-    std::mt19937 rng{rdev()};
-    std::uniform_real_distribution<float> U_dist{0.0, 1.0};  // distribuição uniforme [0,1[
+    sampler.StartPixelSample(x, y, s);
+    if (jitter) {
+        sampler.Get2D(jitterV);
+        cam->GenerateRay(x, y, primary, sampler, jitterV);
+    } else {
+        cam->GenerateRay(x, y, primary, sampler);
+    }
+}
 
-    cam->getResolution(&W, &H);
-    float const sppf = 1.f / spp;
+// the albedo is the fraction of light the surface reflects or transmits:
+// Kd (textured or not) plus the specular components, which would otherwise
+// be black ; a primary ray that hits nothing has albedo 1
+// the pixel is written by the thread rendering its tile only
+void StandardRenderer::AddFeatures (const bool intersected, const Intersection &isect, const Ray &primary) {
+    const int i = primary.pix_y * aov->W + primary.pix_x;
+    if (!intersected) {
+        aov->albedo[i] += RGB(1., 1., 1.);
+        return;
+    }
+    if (isect.isLight) {
+        aov->hits[i] = -1;
+        return;
+    }
+    if (aov->hits[i] < 0) return;
+    BRDF *f = isect.f;
+    RGB a;
+    if (f->textured) {
+        DiffuseTexture *df = (DiffuseTexture *)f;
+        a = df->GetKd(isect.TexCoord, isect.TexFootprint);
+    }
+    else {
+        a = f->Kd;
+    }
+    a += f->Ks;
+    a += f->Kt;
+    a.set(std::min(a.R, 1.f), std::min(a.G, 1.f), std::min(a.B, 1.f));
+    aov->albedo[i] += a;
+    // the normals of the meshes read from files are not necessarily unit length
+    Vector n = isect.sn.Faceforward(isect.wo);
+    n.normalize();
+    aov->normal[i] = aov->normal[i] + n;
+    aov->depth[i] += isect.depth;
+    aov->hits[i]++;
+}
+
+RGB StandardRenderer::ShadePrimary (const bool intersected, Intersection &isect, const Ray &primary, Sampler &sampler) {
+    if (aov != NULL) AddFeatures(intersected, isect, primary);
+    if (eshd != NULL) {
+        return eshd->shade(intersected, isect, 0, sampler, primary.dir);
+    }
+    return shd->shade(intersected, isect, 0, sampler);
+}
+
+RGB StandardRenderer::SamplePixel (const int x, const int y, const int s, Sampler &sampler) {
+    Ray primary;
+    Intersection isect;
+    bool intersected;
 
-    // PARALLEL FOR
-    #pragma omp parallel for private(x, s) schedule(dynamic)
-    for (y = 0; y < H; y++) {
-        std::mt19937 local_rng(rdev()); // rng por thread (não compartilha!)
-        std::uniform_real_distribution<float> local_U_dist{0.0, 1.0};
+    GeneratePrimary(x, y, s, sampler, &primary);
+    intersected = scene->trace(primary, &isect);
+    return ShadePrimary(intersected, isect, primary, sampler);
+}
 
-        for (x = 0; x < W; x++) {
+void StandardRenderer::RenderTile (const Tile &t, Sampler &sampler, RGB *tileBuffer) {
+    float const sppf = 1.f / spp;
+    const int tW = t.x1 - t.x0;
+    for (int y = t.y0; y < t.y1; y++) {
+        for (int x = t.x0; x < t.x1; x++) {
             RGB color(0., 0., 0.);
 
-            for (s = 0; s < spp; s++) {
-                Ray primary;
-                Intersection isect;
-                bool intersected;
-                float jitterV[2];
-
-                if (jitter) {
-                    jitterV[0] = local_U_dist(local_rng);
-                    jitterV[1] = local_U_dist(local_rng);
-                    cam->GenerateRay(x, y, &primary, jitterV);
-                } else {
-                    cam->GenerateRay(x, y, &primary);
-                }
-
-                intersected = scene->trace(primary, &isect);
-
-                if (EnvironmentShader* dshd = dynamic_cast<EnvironmentShader*>(shd)) {
-                    color += dshd->shade(intersected, isect, 0, primary.dir);
-                } else {
-                    color += shd->shade(intersected, isect, 0);
-                }
+            for (int s = 0; s < spp; s++) {
+                color += SamplePixel(x, y, s, sampler);
             }
+            tileBuffer[(y - t.y0) * tW + (x - t.x0)] = color * sppf;
+        }
+    }
+}
+
+void StandardRenderer::Render () {
+    int W = 0, H = 0;  // resolução
 
-            img->set(x, y, color * sppf);
+    cam->getResolution(&W, &H);
+    eshd = dynamic_cast<EnvironmentShader*>(shd);
+    if (aov != NULL) aov->reset(W, H);
+
+    TileScheduler scheduler(W, H, tileSize);
+    scheduler.Start(omp_get_max_threads());
+
+    // feedback de progresso: a single thread reads the scheduler's counter
+    // and is woken up as soon as rendering finishes
+    std::mutex mtx;
+    std::condition_variable finished;
+    bool rendering = true;
+    std::thread reporter([&]() {
+        const int nTiles = scheduler.numTiles();
+        std::unique_lock<std::mutex> lock(mtx);
+        while (rendering) {
+            fprintf(stderr, "%3d%%\r", 100 * scheduler.numTilesDone() / nTiles);
+            finished.wait_for(lock, std::chrono::milliseconds(250));
         }
+        fprintf(stderr, "100%%\n");
+    });
+
+    #pragma omp parallel
+    {
+        const int thread = omp_get_thread_num();
+        // private to this thread
+        // its stream depends only on (seed, x, y, s): see Sampler::StartPixelSample()
+        Sampler sampler(seed);
+        std::vector<RGB> tileBuffer(tileSize * tileSize);
+        Tile t;
+
+        while (scheduler.NextTile(thread, &t)) {
+            const int tW = t.x1 - t.x0;
+            RenderTile(t, sampler, tileBuffer.data());
+            // the tile is written at once: threads never write to the same pixels
+            img->setBlock(t.x0, t.y0, tW, t.y1 - t.y0, tileBuffer.data());
+            scheduler.TileDone();
+        }
+    }
 
-        // feedback de progresso (melhor só uma thread)
-        fprintf(stderr, "%d\r", y);
-        fflush(stderr);
-        
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        rendering = false;
     }
+    finished.notify_one();
+    reporter.join();
+    if (aov != NULL) aov->resolve(spp);
 }
@@ -10,19 +10,48 @@
 
 #include "renderer.hpp"
 #include "EnvironmentShader.hpp"
+#include "TileScheduler.hpp"
+#include "AOVBuffer.hpp"
 
 class StandardRenderer: public Renderer {
-private:
+protected:
     int spp;
     bool jitter;
+    uint64_t seed;   // same seed => same image (see Sampler)
+    int tileSize;    // tiles are tileSize x tileSize pixels (see TileScheduler)
+    EnvironmentShader *eshd;  // shd, if it is an EnvironmentShader (set by Render())
+
+    // primary ray of sample s of pixel (x,y) ; starts the sampler's stream for that sample
+    void GeneratePrimary (const int x, const int y, const int s, Sampler &sampler, Ray *primary);
+    // adds the features of a primary ray's closest intersection to its pixel's on aov
+    void AddFeatures (const bool intersected, const Intersection &isect, const Ray &primary);
+    // radiance carried by a primary ray, given its closest intersection
+    // (and its features added to aov, if not NULL)
+    RGB ShadePrimary (const bool intersected, Intersection &isect, const Ray &primary, Sampler &sampler);
+    // radiance carried by sample s of pixel (x,y)
+    RGB SamplePixel (const int x, const int y, const int s, Sampler &sampler);
+    // the average of the spp samples of each pixel of t, written row major on tileBuffer
+    virtual void RenderTile (const Tile &t, Sampler &sampler, RGB *tileBuffer);
 public:
+    // if not NULL the auxiliary buffers of the frame are written by Render(),
+    // from the same primary rays as the image
+    AOVBuffer *aov;
+
     StandardRenderer (Camera *cam, Scene * scene, Image * img, Shader *shd, int _spp): Renderer(cam, scene, img, shd) {
         spp = _spp;
         jitter = false;
+        seed = 0;
+        tileSize = 16;
+        eshd = NULL;
+        aov = NULL;
     }
-    StandardRenderer (Camera *cam, Scene * scene, Image * img, Shader *shd, int _spp, bool _jitter): Renderer(cam, scene, img, shd) {
+    StandardRenderer (Camera *cam, Scene * scene, Image * img, Shader *shd, int _spp, bool _jitter, uint64_t _seed=0, int _tileSize=16): Renderer(cam, scene, img, shd) {
         spp = _spp;
         jitter = _jitter;
+        seed = _seed;
+        tileSize = _tileSize;
+        eshd = NULL;
+        aov = NULL;
     }
     void Render ();
 };
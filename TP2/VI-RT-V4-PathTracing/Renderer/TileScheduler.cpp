@@ -0,0 +1,71 @@
+//
+//  TileScheduler.cpp
+//  VI-RT-V4-PathTracing
+//
+
+#include "TileScheduler.hpp"
+#include <algorithm>
+#include <stdint.h>
+
+// interleaves the bits of x and y (16 bits each)
+// https://fgiesen.wordpress.com/2009/12/13/decoding-morton-codes/
+static inline uint32_t Part1By1 (uint32_t x) {
+    x &= 0x0000ffff;
+    x = (x ^ (x << 8)) & 0x00ff00ff;
+    x = (x ^ (x << 4)) & 0x0f0f0f0f;
+    x = (x ^ (x << 2)) & 0x33333333;
+    x = (x ^ (x << 1)) & 0x55555555;
+    return x;
+}
+
+static inline uint32_t EncodeMorton2 (uint32_t x, uint32_t y) {
+    return (Part1By1(y) << 1) + Part1By1(x);
+}
+
+TileScheduler::TileScheduler (const int W, const int H, const int tileSize): nRanges(0), tilesDone(0) {
+    const int nX = (W + tileSize - 1) / tileSize;
+    const int nY = (H + tileSize - 1) / tileSize;
+    std::vector<std::pair<uint32_t, Tile> > coded;
+
+    coded.reserve(nX * nY);
+    for (int ty=0 ; ty<nY ; ty++) {
+        for (int tx=0 ; tx<nX ; tx++) {
+            Tile t;
+            t.x0 = tx * tileSize;
+            t.y0 = ty * tileSize;
+            t.x1 = std::min(t.x0 + tileSize, W);
+            t.y1 = std::min(t.y0 + tileSize, H);
+            coded.push_back(std::make_pair(EncodeMorton2(tx, ty), t));
+        }
+    }
+    std::sort(coded.begin(), coded.end(),
+              [](const std::pair<uint32_t, Tile> &a, const std::pair<uint32_t, Tile> &b) { return a.first < b.first; });
+    tiles.reserve(coded.size());
+    for (auto &c : coded) tiles.push_back(c.second);
+}
+
+void TileScheduler::Start (const int nThreads) {
+    const int N = (int)tiles.size();
+    nRanges = (nThreads > 0 ? nThreads : 1);
+    ranges.reset(new TileRange[nRanges]);
+    // contiguous ranges of (almost) equal size: each thread works on a compact region
+    for (int i=0 ; i<nRanges ; i++) {
+        ranges[i].next.store((int)((int64_t)N * i / nRanges));
+        ranges[i].end = (int)((int64_t)N * (i+1) / nRanges);
+    }
+    tilesDone.store(0);
+}
+
+bool TileScheduler::NextTile (const int thread, Tile *t) {
+    // own range first, then steal from the following threads
+    for (int k=0 ; k<nRanges ; k++) {
+        TileRange &r = ranges[(thread + k) % nRanges];
+        if (r.next.load(std::memory_order_relaxed) >= r.end) continue;
+        const int ndx = r.next.fetch_add(1, std::memory_order_relaxed);
+        if (ndx < r.end) {
+            *t = tiles[ndx];
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,49 @@
+//
+//  TileScheduler.hpp
+//  VI-RT-V4-PathTracing
+//
+//  distributes the image plane among the rendering threads in square tiles
+//  tiles are visited in Morton (Z) order, such that consecutive tiles are
+//  close on the image (and in the scene); each thread starts on its own
+//  contiguous range of tiles and steals from the others when it runs out of work
+//
+
+#ifndef TileScheduler_hpp
+#define TileScheduler_hpp
+
+#include <vector>
+#include <atomic>
+#include <memory>
+
+typedef struct Tile {
+    int x0, y0;   // upper left pixel
+    int x1, y1;   // lower right pixel (exclusive)
+} Tile;
+
+class TileScheduler {
+    // tiles [next, end[ still to be rendered by thread i (or stolen from it)
+    // padded to a cache line to avoid false sharing among threads
+    typedef struct TileRange {
+        std::atomic<int> next;
+        int end;
+        char pad[64 - sizeof(std::atomic<int>) - sizeof(int)];
+    } TileRange;
+
+    std::vector<Tile> tiles;
+    std::unique_ptr<TileRange[]> ranges;
+    int nRanges;
+    std::atomic<int> tilesDone;
+public:
+    TileScheduler (const int W, const int H, const int tileSize);
+    // splits the tiles among nThreads threads ; must be called before NextTile()
+    void Start (const int nThreads);
+    // returns false when all tiles have been handed out
+    bool NextTile (const int thread, Tile *t);
+    // to be called by the rendering thread after writing the tile to the image
+    void TileDone (void) { tilesDone.fetch_add(1, std::memory_order_relaxed); }
+    // progress counter: can be read by any thread while rendering
+    int numTilesDone (void) const { return tilesDone.load(std::memory_order_relaxed); }
+    int numTiles (void) const { return (int)tiles.size(); }
+};
+
+#endif /* TileScheduler_hpp */
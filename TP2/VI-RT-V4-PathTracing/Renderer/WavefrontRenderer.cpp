@@ -0,0 +1,211 @@
+//
+//  WavefrontRenderer.cpp
+//  VI-RT-V4-PathTracing
+//
+
+#include "WavefrontRenderer.hpp"
+#include <omp.h>
+#include <stdio.h>
+
+void PathQueue::resize (const int n) {
+    pixel.resize(n);
+    sampler.resize(n);
+    L.resize(n);
+    throughput.resize(n);
+    bsdfPdf.resize(n);
+    prevP.resize(n);
+    prevN.resize(n);
+    o.resize(n);
+    dir.resize(n);
+    rtype.resize(n);
+    eta.resize(n);
+    FaceID.resize(n);
+    coneSpread.resize(n);
+    hit.resize(n);
+    isect.resize(n);
+    alive.resize(n);
+    shadow.resize(n);
+}
+
+// the hit and the flags are recomputed at each bounce: not moved
+void PathQueue::move (const int i, const int j) {
+    pixel[j] = pixel[i];
+    sampler[j] = sampler[i];
+    L[j] = L[i];
+    throughput[j] = throughput[i];
+    bsdfPdf[j] = bsdfPdf[i];
+    prevP[j] = prevP[i];
+    prevN[j] = prevN[i];
+    o[j] = o[i];
+    dir[j] = dir[i];
+    rtype[j] = rtype[i];
+    eta[j] = eta[i];
+    FaceID[j] = FaceID[i];
+    coneSpread[j] = coneSpread[i];
+}
+
+// primary rays for sample s of pixels p0 .. p1-1 (row major)
+// as StandardRenderer::SamplePixel(): the same random streams are used
+void WavefrontRenderer::Generate (const int s, const int p0, const int p1) {
+    paths.size = p1 - p0;
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < paths.size; i++) {
+        const int p = p0 + i;
+        const int x = p % W, y = p / W;
+        Sampler &sampler = paths.sampler[i];
+        Ray primary;
+        float jitterV[2];
+
+        sampler = Sampler(seed);
+        sampler.StartPixelSample(x, y, s);
+        if (jitter) {
+            sampler.Get2D(jitterV);
+            cam->GenerateRay(x, y, &primary, sampler, jitterV);
+        } else {
+            cam->GenerateRay(x, y, &primary, sampler);
+        }
+        paths.pixel[i] = p;
+        paths.L[i] = RGB(0., 0., 0.);
+        paths.throughput[i] = RGB(1., 1., 1.);
+        paths.bsdfPdf[i] = 0.f;
+        paths.o[i] = primary.o;
+        paths.dir[i] = primary.dir;
+        paths.rtype[i] = primary.rtype;
+        paths.eta[i] = primary.propagating_eta;
+        paths.FaceID[i] = primary.FaceID;
+        paths.coneSpread[i] = primary.coneSpread;
+    }
+}
+
+void WavefrontRenderer::ClosestHit (void) {
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int i = 0; i < paths.size; i++) {
+        Ray r(paths.o[i], paths.dir[i], paths.rtype[i]);
+        r.propagating_eta = paths.eta[i];
+        r.FaceID = paths.FaceID[i];
+        r.coneSpread = paths.coneSpread[i];
+        r.pix_x = paths.pixel[i] % W;
+        r.pix_y = paths.pixel[i] / W;
+        paths.hit[i] = scene->trace(r, &paths.isect[i]);
+    }
+}
+
+// the path's vertex at depth: emission, one light sample and the next ray
+// (as one iteration of PathTracing::shade())
+void WavefrontRenderer::Shade (const int depth) {
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int i = 0; i < paths.size; i++) {
+        Intersection &isect = paths.isect[i];
+        paths.alive[i] = paths.shadow[i] = false;
+
+        if (!paths.hit[i] || isect.isLight) {
+            paths.L[i] += paths.throughput[i] * pt->Emitted(paths.hit[i], isect, paths.dir[i], paths.bsdfPdf[i], paths.prevP[i], paths.prevN[i]);
+            continue;
+        }
+
+        Sampler &sampler = paths.sampler[i];
+        LightSample &ls = lightSamples[i];
+        if (pt->SampleDirect(isect, depth, sampler, &ls)) {
+            ls.L = paths.throughput[i] * ls.L;
+            // a light sample without shadow ray (ambient) is added right away
+            if (ls.shadowRay) paths.shadow[i] = true;
+            else paths.L[i] += ls.L;
+        }
+
+        Ray ray;
+        ray.throughput = paths.throughput[i];
+        if (!pt->Continue(isect, depth, sampler, &ray, &paths.bsdfPdf[i])) continue;
+        paths.alive[i] = true;
+        paths.throughput[i] = ray.throughput;
+        paths.prevP[i] = isect.p;
+        paths.prevN[i] = isect.sn;
+        paths.o[i] = ray.o;
+        paths.dir[i] = ray.dir;
+        paths.rtype[i] = ray.rtype;
+        paths.eta[i] = ray.propagating_eta;
+        paths.FaceID[i] = ray.FaceID;
+        paths.coneSpread[i] = ray.coneSpread;
+    }
+}
+
+// gathers the shadow rays generated by Shade()
+void WavefrontRenderer::EnqueueShadows (void) {
+    shadows.clear();
+    for (int i = 0; i < paths.size; i++) {
+        if (!paths.shadow[i]) continue;
+        const LightSample &ls = lightSamples[i];
+        shadows.Add(ls.shadow, ls.maxL, ls.L, ls.light, i);
+    }
+}
+
+// all the shadow rays of the bounce are traced at once, sorted by light and
+// direction (see ShadowQueue::Trace()) ; each belongs to a different path,
+// hence the order in which the contributions are added does not matter
+void WavefrontRenderer::TraceShadows (void) {
+    shadows.Trace(scene);
+    for (int j = 0; j < shadows.size; j++) {
+        if (shadows.visible[j]) paths.L[shadows.target[j]] += shadows.contribution[j];
+    }
+}
+
+// terminated paths are added to their pixel ; the others are moved,
+// in order, to the front of the queue
+void WavefrontRenderer::Compact (void) {
+    int j = 0;
+    for (int i = 0; i < paths.size; i++) {
+        if (paths.alive[i]) {
+            if (i != j) paths.move(i, j);
+            j++;
+        }
+        else {
+            accum[paths.pixel[i]] += paths.L[i];
+        }
+    }
+    paths.size = j;
+}
+
+void WavefrontRenderer::Render () {
+    cam->getResolution(&W, &H);
+    pt = dynamic_cast<PathTracing *>(shd);
+    if (pt == NULL) {
+        fprintf(stderr, "WavefrontRenderer: the shader must be a PathTracing shader\n");
+        return;
+    }
+    const int nPixels = W * H;
+    const int nPaths = (nPixels < maxPaths ? nPixels : maxPaths);
+    paths.resize(nPaths);
+    lightSamples.resize(nPaths);
+    shadows.resize(nPaths);
+    accum.assign(nPixels, RGB(0., 0., 0.));
+
+    // one wave per sample and block of pixels: the samples of each
+    // pixel are added in the same order as StandardRenderer does
+    const long total = (long)spp * nPixels;
+    long done = 0;
+    int reported = -1;
+    for (int s = 0; s < spp; s++) {
+        for (int p0 = 0; p0 < nPixels; p0 += nPaths) {
+            const int p1 = (p0 + nPaths < nPixels ? p0 + nPaths : nPixels);
+            Generate(s, p0, p1);
+            for (int depth = 0; paths.size > 0; depth++) {
+                ClosestHit();
+                Shade(depth);
+                EnqueueShadows();
+                TraceShadows();
+                Compact();
+            }
+            done += p1 - p0;
+            const int pct = (int)(100 * done / total);
+            if (pct != reported && pct < 100) fprintf(stderr, "%3d%%\r", pct);
+            reported = pct;
+        }
+    }
+    fprintf(stderr, "100%%\n");
+
+    const float sppf = 1.f / spp;
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            img->set(x, y, accum[y * W + x] * sppf);
+        }
+    }
+}
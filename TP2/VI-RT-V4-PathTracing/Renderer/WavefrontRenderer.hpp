@@ -0,0 +1,86 @@
+//
+//  WavefrontRenderer.hpp
+//  VI-RT-V4-PathTracing
+//
+//  path tracing with many paths advanced in lockstep: each stage
+//  (ray generation, closest hit, shading, shadow rays) is a batch loop
+//  over a queue of paths stored as structures of arrays, and the paths
+//  that terminate are compacted out of the queue after each bounce
+//  based on Laine et al., "Megakernels Considered Harmful: Wavefront
+//  Path Tracing on GPUs", HPG 2013 and pbrt 4th edition, sec 15.1
+//
+//  the integrator is PathTracing's (see PathTracing::Emitted(), SampleDirect()
+//  and Continue()) ; the shader must be a PathTracing shader
+//
+
+#ifndef WavefrontRenderer_hpp
+#define WavefrontRenderer_hpp
+
+#include "renderer.hpp"
+#include "PathTracingShader.hpp"
+#include "ShadowQueue.hpp"
+#include <vector>
+#include <stdint.h>
+
+// the paths being traced, one entry per path
+typedef struct PathQueue {
+    int size;
+    std::vector<int> pixel;          // y*W + x
+    std::vector<Sampler> sampler;    // each path has its own random stream
+    std::vector<RGB> L;              // radiance gathered so far
+    std::vector<RGB> throughput;
+    std::vector<float> bsdfPdf;      // of the last bounce, 0 if not diffuse (see PathTracing)
+    std::vector<Point> prevP;        // where the last diffuse bounce occurred
+    std::vector<Vector> prevN;
+    // next ray to trace
+    std::vector<Point> o;
+    std::vector<Vector> dir;
+    std::vector<RayType> rtype;
+    std::vector<float> eta;
+    std::vector<int> FaceID;
+    std::vector<float> coneSpread;
+    // closest hit of that ray
+    std::vector<char> hit;
+    std::vector<Intersection> isect;
+    // set by the shading stage
+    std::vector<char> alive;         // the path continues
+    std::vector<char> shadow;        // a shadow ray was generated
+
+    void resize (const int n);
+    // moves path i to slot j (j <= i)
+    void move (const int i, const int j);
+} PathQueue;
+
+class WavefrontRenderer: public Renderer {
+    int spp;
+    bool jitter;
+    uint64_t seed;    // same seed => same image (see Sampler)
+    int maxPaths;     // maximum number of paths in flight
+    PathTracing *pt;  // shd (set by Render())
+    int W, H;
+
+    PathQueue paths;
+    std::vector<LightSample> lightSamples;  // per path, written by Shade()
+    ShadowQueue shadows;   // target: the path
+    std::vector<RGB> accum;   // per pixel sum of the samples
+
+    // the stages, over all the paths in flight
+    void Generate (const int s, const int p0, const int p1);
+    void ClosestHit (void);
+    void Shade (const int depth);
+    void EnqueueShadows (void);
+    void TraceShadows (void);
+    void Compact (void);
+public:
+    WavefrontRenderer (Camera *cam, Scene * scene, Image * img, Shader *shd, int _spp, bool _jitter=true, uint64_t _seed=0, int _maxPaths=1<<16): Renderer(cam, scene, img, shd) {
+        spp = _spp;
+        jitter = _jitter;
+        seed = _seed;
+        maxPaths = _maxPaths;
+        pt = NULL;
+        W = H = 0;
+    }
+    void Render ();
+};
+
+#endif /* WavefrontRenderer_hpp */
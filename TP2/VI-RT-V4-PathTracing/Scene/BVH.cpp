@@ -0,0 +1,554 @@
+//
+//  BVH.cpp
+//  VI-RT-V4-PathTracing
+//
+//  Bounding Volume Hierarchy over the scene's primitives and area lights
+//  based on pbrt 3rd edition, sec 4.3 and 4.4 (pbrt.org)
+//
+
+#include "BVH.hpp"
+#include "triangle.hpp"
+#include <algorithm>
+
+static inline float axisValue (const Point &p, const int axis) {
+    return (axis==0 ? p.X : (axis==1 ? p.Y : p.Z));
+}
+
+void BVH::Build (const std::vector<BVHItem> &_items) {
+    const int N = (int)_items.size();
+    std::vector<BVHItem> unordered = _items;
+    std::vector<BB> itemBounds(N);
+    std::vector<Point> centroids(N);
+    std::vector<int> ndx(N);
+
+    Clear();
+    if (N==0) return;
+
+    for (int i=0 ; i<N ; i++) {
+        itemBounds[i] = unordered[i].g->bb;
+        centroids[i] = itemBounds[i].Centroid();
+        ndx[i] = i;
+    }
+    // the binary tree has at most 2*N-1 nodes
+    std::vector<LinearBVHNode> tree;
+    tree.reserve(2*N);
+    items.reserve(N);
+    recursiveBuild(tree, ndx, 0, N, itemBounds, centroids, 0);
+    // each leaf refers to a contiguous range of the permuted ndx
+    for (int i=0 ; i<N ; i++) {
+        items.push_back(unordered[ndx[i]]);
+    }
+    // collapse into 4-wide nodes
+    nodes.reserve(tree.size()/2 + 1);
+    if (tree[0].nItems > 0) {
+        // a single leaf: the root has one non empty slot
+        BVH4Node root;
+        root.bounds.set(0, tree[0].bounds);
+        setLeaf(root, 0, tree[0].itemsOffset, tree[0].nItems);
+        for (int i=1 ; i<4 ; i++) {
+            root.bounds.setEmpty(i);
+            root.child[i] = -1;
+            root.nItems[i] = 0;
+        }
+        nodes.push_back(root);
+    }
+    else collapse(tree, 0);
+}
+
+// Creates the 4-wide node for the binary interior node n and returns its index on nodes
+// children are gathered by repeatedly opening the interior child with
+// the largest surface area; nodes are created depth first, hence
+// children indices are always larger than their parent's
+int BVH::collapse (const std::vector<LinearBVHNode> &tree, const int n) {
+    int c[4], nc = 0;
+    c[nc++] = n + 1;
+    c[nc++] = tree[n].secondChildOffset;
+    while (nc < 4) {
+        int best = -1;
+        float bestArea = -1.f;
+        for (int i=0 ; i<nc ; i++) {
+            if (tree[c[i]].nItems > 0) continue;
+            const float area = tree[c[i]].bounds.SurfaceArea();
+            if (area > bestArea) {
+                bestArea = area;
+                best = i;
+            }
+        }
+        if (best < 0) break;   // all children are leaves
+        const int m = c[best];
+        c[best] = m + 1;
+        c[nc++] = tree[m].secondChildOffset;
+    }
+    const int nodeNdx = (int)nodes.size();
+    nodes.push_back(BVH4Node());
+    for (int i=0 ; i<4 ; i++) {
+        if (i >= nc) {
+            nodes[nodeNdx].bounds.setEmpty(i);
+            nodes[nodeNdx].child[i] = -1;
+            nodes[nodeNdx].nItems[i] = 0;
+            continue;
+        }
+        const LinearBVHNode &tn = tree[c[i]];
+        nodes[nodeNdx].bounds.set(i, tn.bounds);
+        if (tn.nItems > 0) {
+            setLeaf(nodes[nodeNdx], i, tn.itemsOffset, tn.nItems);
+        }
+        else {
+            // nodes may be reallocated by collapse()
+            const int childNdx = collapse(tree, c[i]);
+            nodes[nodeNdx].child[i] = childNdx;
+            nodes[nodeNdx].nItems[i] = 0;
+        }
+    }
+    return nodeNdx;
+}
+
+// Builds the binary sub tree over ndx[start..end[ and returns its root index on tree
+// depth is the depth of this root (see maxSAHDepth)
+// pbrt 3rd edition, sec 4.3.1 and 4.3.2, pag 259 .. 270
+int BVH::recursiveBuild (std::vector<LinearBVHNode> &tree, std::vector<int> &ndx, int start, int end,
+                         std::vector<BB> &itemBounds, std::vector<Point> &centroids, const int depth) {
+    const int nodeNdx = (int)tree.size();
+    tree.push_back(LinearBVHNode());
+
+    BB bounds;
+    bounds.setEmpty();
+    for (int i=start ; i<end ; i++) bounds.Union(itemBounds[ndx[i]]);
+    tree[nodeNdx].bounds = bounds;
+
+    const int nItems = end - start;
+    // bounds of the centroids, used to choose the split axis
+    BB centroidBounds;
+    centroidBounds.setEmpty();
+    for (int i=start ; i<end ; i++) centroidBounds.update(centroids[ndx[i]]);
+    const int dim = centroidBounds.MaximumExtent();
+    const float cMin = axisValue(centroidBounds.min, dim);
+    const float cMax = axisValue(centroidBounds.max, dim);
+
+    // create a leaf if there is a single item or if all centroids coincide
+    // (and the items fit: LinearBVHNode::nItems is 16 bits wide)
+    if (nItems == 1 || (cMax == cMin && nItems <= maxItemsInNode)) {
+        tree[nodeNdx].itemsOffset = start;
+        tree[nodeNdx].nItems = (unsigned short)nItems;
+        tree[nodeNdx].axis = 0;
+        return nodeNdx;
+    }
+
+    // past maxSAHDepth (degenerate SAH splits): a leaf if it fits, else the median
+    if (depth >= maxSAHDepth && nItems <= maxItemsInNode) {
+        tree[nodeNdx].itemsOffset = start;
+        tree[nodeNdx].nItems = (unsigned short)nItems;
+        tree[nodeNdx].axis = 0;
+        return nodeNdx;
+    }
+
+    int mid;
+    if (cMax == cMin) {
+        // no axis separates the items: halves of the range
+        mid = (start + end) / 2;
+    }
+    else if (nItems <= 2 || depth >= maxSAHDepth) {
+        // partition into equally sized subsets
+        mid = (start + end) / 2;
+        std::nth_element(ndx.begin()+start, ndx.begin()+mid, ndx.begin()+end,
+            [&](int a, int b) { return axisValue(centroids[a], dim) < axisValue(centroids[b], dim); });
+    }
+    else {
+        // Surface Area Heuristic over nBuckets equally sized buckets
+        const int nBuckets = 12;
+        int count[nBuckets];
+        BB bucketBounds[nBuckets];
+        for (int b=0 ; b<nBuckets ; b++) {
+            count[b] = 0;
+            bucketBounds[b].setEmpty();
+        }
+        auto bucketOf = [&](int item) {
+            int b = (int)(nBuckets * (axisValue(centroids[item], dim) - cMin) / (cMax - cMin));
+            return (b >= nBuckets ? nBuckets-1 : b);
+        };
+        for (int i=start ; i<end ; i++) {
+            const int b = bucketOf(ndx[i]);
+            count[b]++;
+            bucketBounds[b].Union(itemBounds[ndx[i]]);
+        }
+        // cost of splitting after each bucket
+        // traversal cost is 1/8 of an item intersection cost
+        float cost[nBuckets-1];
+        for (int i=0 ; i<nBuckets-1 ; i++) {
+            BB b0, b1;
+            b0.setEmpty();
+            b1.setEmpty();
+            int count0 = 0, count1 = 0;
+            for (int j=0 ; j<=i ; j++) {
+                b0.Union(bucketBounds[j]);
+                count0 += count[j];
+            }
+            for (int j=i+1 ; j<nBuckets ; j++) {
+                b1.Union(bucketBounds[j]);
+                count1 += count[j];
+            }
+            cost[i] = .125f + (count0 * (count0 ? b0.SurfaceArea() : 0.f) +
+                               count1 * (count1 ? b1.SurfaceArea() : 0.f)) / bounds.SurfaceArea();
+        }
+        int minCostSplitBucket = 0;
+        float minCost = cost[0];
+        for (int i=1 ; i<nBuckets-1 ; i++) {
+            if (cost[i] < minCost) {
+                minCost = cost[i];
+                minCostSplitBucket = i;
+            }
+        }
+        const float leafCost = (float)nItems;
+        if (nItems <= maxItemsInNode && minCost >= leafCost) {
+            tree[nodeNdx].itemsOffset = start;
+            tree[nodeNdx].nItems = (unsigned short)nItems;
+            tree[nodeNdx].axis = 0;
+            return nodeNdx;
+        }
+        auto pmid = std::partition(ndx.begin()+start, ndx.begin()+end,
+            [&](int item) { return bucketOf(item) <= minCostSplitBucket; });
+        mid = (int)(pmid - ndx.begin());
+        if (mid == start || mid == end) {
+            mid = (start + end) / 2;
+            std::nth_element(ndx.begin()+start, ndx.begin()+mid, ndx.begin()+end,
+                [&](int a, int b) { return axisValue(centroids[a], dim) < axisValue(centroids[b], dim); });
+        }
+    }
+    // the first child is the next node on the array
+    recursiveBuild(tree, ndx, start, mid, itemBounds, centroids, depth+1);
+    const int second = recursiveBuild(tree, ndx, mid, end, itemBounds, centroids, depth+1);
+    tree[nodeNdx].secondChildOffset = second;
+    tree[nodeNdx].nItems = 0;
+    tree[nodeNdx].axis = (unsigned char)dim;
+    return nodeNdx;
+}
+
+// a leaf is packed in a TriangleBlock if all its items are triangles
+void BVH::setLeaf (BVH4Node &node, const int slot, const int itemsOffset, const int nItems) {
+    bool pack = packTriangles && nItems <= TriangleBlock::width;
+    for (int i=0 ; i<nItems && pack ; i++) {
+        pack = (dynamic_cast<Triangle *>(items[itemsOffset+i].g) != NULL);
+    }
+    if (!pack) {
+        node.child[slot] = itemsOffset;
+        node.nItems[slot] = nItems;
+        return;
+    }
+    TriangleBlock b;
+    b.clear();
+    for (int i=0 ; i<nItems ; i++) {
+        const BVHItem &item = items[itemsOffset+i];
+        b.set(i, (Triangle *)item.g, itemsOffset+i, item.light_ndx < 0);
+    }
+    node.child[slot] = (int)blocks.size();
+    node.nItems[slot] = -nItems;
+    blocks.push_back(b);
+}
+
+// children indices are always larger than their parent's (see collapse()),
+// hence visiting the nodes in reverse order updates children before parents
+void BVH::Refit (void) {
+    for (int b=0 ; b<(int)blocks.size() ; b++) {
+        TriangleBlock &block = blocks[b];
+        for (int lane=0 ; lane<TriangleBlock::width ; lane++) {
+            const int i = block.item[lane];
+            if (i < 0) continue;
+            block.set(lane, (Triangle *)items[i].g, i, items[i].light_ndx < 0);
+        }
+    }
+    for (int n=(int)nodes.size()-1 ; n>=0 ; n--) {
+        BVH4Node &node = nodes[n];
+        for (int slot=0 ; slot<4 ; slot++) {
+            if (node.child[slot] < 0) continue;   // empty slot
+            BB bounds;
+            bounds.setEmpty();
+            if (node.nItems[slot] > 0) {
+                for (int i=0 ; i<node.nItems[slot] ; i++) {
+                    bounds.Union(items[node.child[slot]+i].g->bb);
+                }
+            }
+            else if (node.nItems[slot] < 0) {
+                const TriangleBlock &block = blocks[node.child[slot]];
+                for (int lane=0 ; lane<-node.nItems[slot] ; lane++) {
+                    bounds.Union(items[block.item[lane]].g->bb);
+                }
+            }
+            else {
+                const BVH4Node &child = nodes[node.child[slot]];
+                for (int c=0 ; c<4 ; c++) {
+                    if (child.child[c] >= 0) bounds.Union(child.bounds.get(c));
+                }
+            }
+            node.bounds.set(slot, bounds);
+        }
+    }
+}
+
+// stack entry of the traversal: either a node or a leaf (items range)
+typedef struct BVHStackEntry {
+    int child, nItems;
+    float tNear;
+} BVHStackEntry;
+
+// children are visited front to back, using the entry distance returned by the box test
+// pbrt 3rd edition, sec 4.4, pag 282
+bool BVH::Intersect (const Ray &r, HitRecord *hit) const {
+    bool found = false;
+    HitRecord curr;
+
+    if (nodes.empty()) return false;
+    hit->t = MAXFLOAT;
+
+    // each visited node pushes at most 4 entries and pops 1 (see stackSize)
+    BVHStackEntry stack[stackSize];
+    int sp = 0;
+    stack[sp].child = 0; stack[sp].nItems = 0; stack[sp].tNear = 0.f;
+    sp++;
+    while (sp > 0) {
+        const BVHStackEntry e = stack[--sp];
+        // an intersection closer than the entry point has been found meanwhile
+        if (e.tNear > hit->t) continue;
+        if (e.nItems > 0) {
+            // leaf: intersect the ray with its items
+            for (int i=0 ; i<e.nItems ; i++) {
+                const int ndx = e.child + i;
+                if (items[ndx].g->hit(r, hit->t, &curr)) {
+                    found = true;
+                    *hit = curr;
+                    hit->item = ndx;
+                }
+            }
+            continue;
+        }
+        if (e.nItems < 0) {
+            // packed leaf
+            if (IntersectTriangleBlock(blocks[e.child], r, hit)) found = true;
+            continue;
+        }
+        const BVH4Node &node = nodes[e.child];
+        float tNear[4];
+        const int mask = node.bounds.intersect(r, hit->t, tNear);
+        // sort the intersected children by decreasing entry distance
+        // such that the closest one is on top of the stack
+        int order[4], nHits = 0;
+        for (int i=0 ; i<4 ; i++) {
+            if (!(mask & (1 << i))) continue;
+            int j = nHits++;
+            while (j > 0 && tNear[order[j-1]] < tNear[i]) {
+                order[j] = order[j-1];
+                j--;
+            }
+            order[j] = i;
+        }
+        for (int k=0 ; k<nHits ; k++) {
+            const int i = order[k];
+            stack[sp].child = node.child[i];
+            stack[sp].nItems = node.nItems[i];
+            stack[sp].tNear = tNear[i];
+            sp++;
+        }
+    }
+    return found;
+}
+
+// stack entry of the packet traversal: active has bit k set
+// for the rays of the packet that intersect the entry's box
+typedef struct BVHPacketStackEntry {
+    int child, nItems;
+    uint64_t active;
+} BVHPacketStackEntry;
+
+// the packet is traversed as a whole: the children of each node are first
+// tested for all the rays at once (see BB4::intersect(const RayPacket &, ...)) ;
+// only those that are neither missed nor entered by all the active rays are
+// tested ray by ray. The children are visited front to back for the packet
+// and each leaf is intersected with the rays that reached it only
+// Wald et al., "Interactive Rendering with Coherent Ray Tracing", EG 2001
+void BVH::IntersectPacket (const RayPacket &p, HitRecord *hits, bool *found) const {
+    for (int k=0 ; k<p.size ; k++) {
+        found[k] = false;
+        hits[k].t = MAXFLOAT;
+    }
+    if (nodes.empty() || p.size == 0) return;
+
+    BVHPacketStackEntry stack[stackSize];
+    int sp = 0;
+    stack[sp].child = 0; stack[sp].nItems = 0; stack[sp].active = p.allRays();
+    sp++;
+    while (sp > 0) {
+        const BVHPacketStackEntry e = stack[--sp];
+        if (e.nItems != 0) {
+            // leaf
+            for (uint64_t m = e.active ; m ; m &= m-1) {
+                const int k = __builtin_ctzll(m);
+                if (e.nItems < 0) {
+                    if (IntersectTriangleBlock(blocks[e.child], p.r[k], &hits[k])) found[k] = true;
+                    continue;
+                }
+                HitRecord curr;
+                for (int i=0 ; i<e.nItems ; i++) {
+                    const int ndx = e.child + i;
+                    if (items[ndx].g->hit(p.r[k], hits[k].t, &curr)) {
+                        found[k] = true;
+                        hits[k] = curr;
+                        hits[k].item = ndx;
+                    }
+                }
+            }
+            continue;
+        }
+        const BVH4Node &node = nodes[e.child];
+        // the rays' ranges are up to their closest hits so far
+        float tMin = MAXFLOAT, tMax = 0.f;
+        for (uint64_t m = e.active ; m ; m &= m-1) {
+            const float t = hits[__builtin_ctzll(m)].t;
+            tMin = fminf(tMin, t);
+            tMax = fmaxf(tMax, t);
+        }
+        float childNear[4];
+        int all;
+        const int any = node.bounds.intersect(p, tMin, tMax, childNear, &all);
+        if (any == 0) continue;
+
+        // the children entered by some but not all of the rays are tested ray by ray
+        uint64_t childActive[4];
+        for (int i=0 ; i<4 ; i++) {
+            childActive[i] = ((all & (1 << i)) ? e.active : 0);
+        }
+        if (any & ~all) {
+            for (uint64_t m = e.active ; m ; m &= m-1) {
+                const int k = __builtin_ctzll(m);
+                float tNear[4];
+                const int mask = node.bounds.intersect(p.r[k], hits[k].t, tNear) & any & ~all;
+                for (int i=0 ; i<4 ; i++) {
+                    if (mask & (1 << i)) childActive[i] |= (uint64_t)1 << k;
+                }
+            }
+        }
+        // sort the intersected children by decreasing entry distance
+        // such that the closest one is on top of the stack
+        int order[4], nHits = 0;
+        for (int i=0 ; i<4 ; i++) {
+            if (childActive[i] == 0) continue;
+            int j = nHits++;
+            while (j > 0 && childNear[order[j-1]] < childNear[i]) {
+                order[j] = order[j-1];
+                j--;
+            }
+            order[j] = i;
+        }
+        for (int k=0 ; k<nHits ; k++) {
+            const int i = order[k];
+            stack[sp].child = node.child[i];
+            stack[sp].nItems = node.nItems[i];
+            stack[sp].active = childActive[i];
+            sp++;
+        }
+    }
+}
+
+// light sources are not occluders (as in Scene::visibility())
+bool BVH::IntersectP (const Ray &r, const float tMax) const {
+    if (nodes.empty()) return false;
+
+    int stack[stackSize];
+    int sp = 0;
+    stack[sp++] = 0;
+    while (sp > 0) {
+        const BVH4Node &node = nodes[stack[--sp]];
+        float tNear[4];
+        const int mask = node.bounds.intersect(r, tMax, tNear);
+        for (int i=0 ; i<4 ; i++) {
+            if (!(mask & (1 << i))) continue;
+            if (node.nItems[i] == 0) {
+                stack[sp++] = node.child[i];
+                continue;
+            }
+            if (node.nItems[i] < 0) {
+                if (OccludedTriangleBlock(blocks[node.child[i]], r, tMax)) return true;
+                continue;
+            }
+            for (int j=0 ; j<node.nItems[i] ; j++) {
+                const BVHItem &item = items[node.child[i] + j];
+                if (item.light_ndx >= 0) continue;
+                // the first blocker found terminates the traversal
+                if (item.g->occluded(r, tMax)) {
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+// as IntersectPacket(), without ordering the children: each ray
+// leaves the packet as soon as a blocker is found for it
+void BVH::IntersectPacketP (const RayPacket &p, const float *tMax, bool *occluded) const {
+    for (int k=0 ; k<p.size ; k++) occluded[k] = false;
+    if (nodes.empty() || p.size == 0) return;
+
+    // the ranges of the whole packet: bounds for those of the active rays
+    float tMinP = MAXFLOAT, tMaxP = 0.f;
+    for (int k=0 ; k<p.size ; k++) {
+        tMinP = fminf(tMinP, tMax[k]);
+        tMaxP = fmaxf(tMaxP, tMax[k]);
+    }
+    uint64_t blocked = 0;
+    BVHPacketStackEntry stack[stackSize];
+    int sp = 0;
+    stack[sp].child = 0; stack[sp].nItems = 0; stack[sp].active = p.allRays();
+    sp++;
+    while (sp > 0) {
+        BVHPacketStackEntry e = stack[--sp];
+        e.active &= ~blocked;
+        if (e.active == 0) continue;
+        if (e.nItems != 0) {
+            // leaf
+            for (uint64_t m = e.active ; m ; m &= m-1) {
+                const int k = __builtin_ctzll(m);
+                bool o = false;
+                if (e.nItems < 0) {
+                    o = OccludedTriangleBlock(blocks[e.child], p.r[k], tMax[k]);
+                }
+                else {
+                    for (int i=0 ; i<e.nItems && !o ; i++) {
+                        const BVHItem &item = items[e.child + i];
+                        if (item.light_ndx >= 0) continue;
+                        o = item.g->occluded(p.r[k], tMax[k]);
+                    }
+                }
+                if (o) {
+                    occluded[k] = true;
+                    blocked |= (uint64_t)1 << k;
+                }
+            }
+            continue;
+        }
+        const BVH4Node &node = nodes[e.child];
+        float tNear[4];
+        int all;
+        const int any = node.bounds.intersect(p, tMinP, tMaxP, tNear, &all);
+        if (any == 0) continue;
+
+        uint64_t childActive[4];
+        for (int i=0 ; i<4 ; i++) {
+            childActive[i] = ((all & (1 << i)) ? e.active : 0);
+        }
+        if (any & ~all) {
+            for (uint64_t m = e.active ; m ; m &= m-1) {
+                const int k = __builtin_ctzll(m);
+                const int mask = node.bounds.intersect(p.r[k], tMax[k], tNear) & any & ~all;
+                for (int i=0 ; i<4 ; i++) {
+                    if (mask & (1 << i)) childActive[i] |= (uint64_t)1 << k;
+                }
+            }
+        }
+        for (int i=0 ; i<4 ; i++) {
+            if (childActive[i] == 0) continue;
+            stack[sp].child = node.child[i];
+            stack[sp].nItems = node.nItems[i];
+            stack[sp].active = childActive[i];
+            sp++;
+        }
+    }
+}
@@ -0,0 +1,107 @@
+//
+//  BVH.hpp
+//  VI-RT-V4-PathTracing
+//
+//  Bounding Volume Hierarchy over the scene's primitives and area lights
+//  based on pbrt 3rd edition, sec 4.3 and 4.4 (pbrt.org)
+//
+
+#ifndef BVH_hpp
+#define BVH_hpp
+
+#include <vector>
+#include "BB.hpp"
+#include "BB4.hpp"
+#include "TriangleBlock.hpp"
+#include "geometry.hpp"
+#include "ray.hpp"
+#include "RayPacket.hpp"
+#include "intersection.hpp"
+
+// one entry per intersectable object: either a scene primitive
+// or the geometry of an area light source
+typedef struct BVHItem {
+    Geometry *g;
+    int prim_ndx;    // index on Scene::prims  ; -1 if this is a light
+    int light_ndx;   // index on Scene::lights ; -1 if this is a primitive
+} BVHItem;
+
+// binary tree produced by the SAH build
+// nodes are stored depth first on a contiguous array:
+// the first child of an interior node is the next node on the array
+// pbrt 3rd edition, sec 4.3.4, pag 280
+typedef struct LinearBVHNode {
+    BB bounds;
+    union {
+        int itemsOffset;        // leaf
+        int secondChildOffset;  // interior
+    };
+    unsigned short nItems;      // 0 for interior nodes
+    unsigned char axis;         // interior node: split axis
+    unsigned char pad[1];       // ensure 32 byte total size
+} LinearBVHNode;
+
+// 4-wide node used for traversal: the binary tree is collapsed such that
+// the bounds of up to 4 children are tested at once (see BB4.hpp)
+// Dammertz et al., "Shallow Bounding Volume Hierarchies for Fast SIMD
+// Ray Tracing of Incoherent Rays", EGSR 2008
+// leaves whose items are all triangles are packed in a TriangleBlock
+typedef struct BVH4Node {
+    BB4 bounds;       // children bounds
+    int child[4];     // leaf: offset on items (or index on blocks if packed) ;
+                      // interior: index on nodes ; -1: empty slot
+    int nItems[4];    // leaf: number of items (negated if packed) ;
+                      // 0 for interior nodes and empty slots
+} BVH4Node;
+
+class BVH {
+    // below this depth the items are no longer split by the SAH but at the
+    // median, hence the binary tree (and the 4-wide one) is at most
+    // maxSAHDepth + 31 levels deep (N < 2^31)
+    static const int maxSAHDepth = 32;
+    static const int maxDepth = maxSAHDepth + 31;
+    // the traversal stack holds at most 3 siblings of each node on the path
+    // from the root, plus the node being visited and its siblings
+    static const int stackSize = 3 * maxDepth + 1;
+    int maxItemsInNode;
+    bool packTriangles;
+    std::vector<BVH4Node> nodes;
+    TriangleBlocks blocks;
+    int recursiveBuild (std::vector<LinearBVHNode> &tree, std::vector<int> &ndx, int start, int end,
+                        std::vector<BB> &itemBounds, std::vector<Point> &centroids, const int depth);
+    int collapse (const std::vector<LinearBVHNode> &tree, const int n);
+    void setLeaf (BVH4Node &node, const int slot, const int itemsOffset, const int nItems);
+public:
+    std::vector<BVHItem> items;  // ordered such that each leaf refers to a contiguous range
+
+    // leaves hold up to TriangleBlock::width items such that a leaf is a single block
+    BVH (int _maxItemsInNode=TriangleBlock::width, bool _packTriangles=true):
+        maxItemsInNode(_maxItemsInNode), packTriangles(_packTriangles) {}
+    // builds the hierarchy over _items, using the surface area heuristic
+    void Build (const std::vector<BVHItem> &_items);
+    // updates the bounds (and packed triangles) after the items' geometry was
+    // changed in place; the topology is kept, hence the hierarchy quality
+    // degrades with large motions (Build() again in that case)
+    // Wald et al., "Ray Tracing Deformable Scenes using Dynamic
+    // Bounding Volume Hierarchies", ACM TOG 26(1), 2007
+    void Refit (void);
+    void Clear (void) { nodes.clear(); blocks.clear(); items.clear(); }
+    bool isBuilt (void) const { return !nodes.empty(); }
+    int numNodes (void) const { return (int)nodes.size(); }
+    int numBlocks (void) const { return (int)blocks.size(); }
+    // closest intersection; hit->item is the index (on items) of the intersected item
+    // the surface attributes are computed by the caller (see Geometry::finalize())
+    // r.invDir must have been set (see Ray::invertDir())
+    bool Intersect (const Ray &r, HitRecord *hit) const;
+    // closest intersection of each ray of the packet, as Intersect() ;
+    // found[k] is set if ray k intersects some item (hits[k] is then valid)
+    // p.coherent must be true (see RayPacket::ComputeBounds())
+    void IntersectPacket (const RayPacket &p, HitRecord *hits, bool *found) const;
+    // any intersection closer than tMax with items that are not light sources
+    bool IntersectP (const Ray &r, const float tMax) const;
+    // IntersectP() for each ray k of the packet, up to tMax[k]: occluded[k]
+    // p.coherent must be true (see RayPacket::ComputeBounds())
+    void IntersectPacketP (const RayPacket &p, const float *tMax, bool *occluded) const;
+};
+
+#endif /* BVH_hpp */
@@ -9,15 +9,22 @@
 #include "DiffuseTexture.hpp"
 #include "../utils/common.hpp"
 #include "../Matrix/matrix.hpp"
+#include <algorithm>
 
 static int AddDiffuseMat (Scene& scene, RGB const color);
 static int AddMat (Scene& scene, RGB const Ka, RGB const Kd, RGB const Ks, RGB const Kt, float const eta=1.f);
 static int AddTextMat (Scene& scene, std::string filename, RGB const Ka, RGB const Kd, RGB const Ks, RGB const Kt, float const eta=1.f);
-static void AddSphere (Scene& scene, Point const C, float const radius,
+static int AddSphere (Scene& scene, Point const C, float const radius,
                             int const mat_ndx);
-static void AddTriangle (Scene& scene,
+static int AddTriangle (Scene& scene,
                         Point const v1, Point const v2, Point const v3,
                         int const mat_ndx);
+static void AddModelTriangle (Scene& scene, Model& model,
+                              int const i1, int const i2, int const i3,
+                              int const mat_ndx);
+static void AddModelSphere (Scene& scene, Model& model, int const mat_ndx);
+static void UpdateModels (Scene& scene, std::vector<Model>& models,
+                          std::vector<int> const& moved);
 
 
 static int AddDiffuseMat (Scene& scene, RGB const color) {
@@ -57,16 +64,16 @@ static int AddMat (Scene& scene, RGB const Ka, RGB const Kd, RGB const Ks, RGB c
     return (scene.AddMaterial(brdf));
 }
 
-static void AddSphere (Scene& scene, Point const C,
+static int AddSphere (Scene& scene, Point const C,
                              float const radius, int const mat_ndx) {
     Sphere *sphere = new Sphere(C, radius);
     Primitive *prim = new Primitive;
     prim->g = sphere;
     prim->material_ndx = mat_ndx;
-    scene.AddPrimitive(prim);
+    return (scene.AddPrimitive(prim));
 }
 
-static void AddTriangle (Scene& scene,
+static int AddTriangle (Scene& scene,
                          Point const v1, Point const v2, Point const v3,
                          int const mat_ndx) {
     
@@ -74,7 +81,45 @@ static void AddTriangle (Scene& scene,
     Primitive *prim = new Primitive;
     prim->g = tri;
     prim->material_ndx = mat_ndx;
-    scene.AddPrimitive(prim);
+    return (scene.AddPrimitive(prim));
+}
+
+// triangle with the model's vertices i1, i2 and i3
+static void AddModelTriangle (Scene& scene, Model& model,
+                              int const i1, int const i2, int const i3,
+                              int const mat_ndx) {
+    const int prim_ndx = AddTriangle(scene, model.vertices[i1], model.vertices[i2], model.vertices[i3], mat_ndx);
+    model.prims.push_back(prim_ndx);
+    model.prim_vertices.push_back(i1);
+    model.prim_vertices.push_back(i2);
+    model.prim_vertices.push_back(i3);
+}
+
+// sphere centered at the model's first vertex
+static void AddModelSphere (Scene& scene, Model& model, int const mat_ndx) {
+    const int prim_ndx = AddSphere(scene, model.vertices[0], model.radius, mat_ndx);
+    model.prims.push_back(prim_ndx);
+    model.prim_vertices.push_back(0);
+    model.prim_vertices.push_back(-1);
+    model.prim_vertices.push_back(-1);
+}
+
+// copies the (transformed) vertices of the moved models to their primitives
+static void UpdateModels (Scene& scene, std::vector<Model>& models,
+                          std::vector<int> const& moved) {
+    for (int model_index : moved) {
+        Model& model = models[model_index];
+        for (size_t p = 0; p < model.prims.size(); p++) {
+            Geometry *g = scene.GetGeometry(model.prims[p]);
+            const int *v = &model.prim_vertices[3*p];
+            if (v[1] < 0) {
+                ((Sphere *)g)->set(model.vertices[v[0]], model.radius);
+            } else {
+                ((Triangle *)g)->setVertices(model.vertices[v[0]], model.vertices[v[1]], model.vertices[v[2]]);
+            }
+        }
+    }
+    if (!moved.empty()) scene.MovedPrimitives();
 }
 
 static void AddTriangleUV (Scene& scene,
@@ -141,27 +186,62 @@ void SpheresTriScene (Scene& scene) {
     return ;
 }
 
-void matrixesCheck(int frame, std::vector<Matrix>& matrixes, std::vector<Model>& models) {
+// brings the models to the given frame, in any order: each model's vertices are
+// its rest vertices transformed by its keyframes evaluated at that frame, in the
+// order of their start frames (see Matrix::evaluate())
+// returns the indices of the models that moved since their previous frame
+std::vector<int> matrixesCheck(int frame, std::vector<Matrix>& matrixes, std::vector<Model>& models) {
+    std::vector<int> moved;
 
     for (auto& matrix : matrixes) {
-        if (frame >= matrix.frame && frame < matrix.frame + matrix.totalFrames) {
-            // Apply transformations to the models based on the matrix
-            for (int model_index : matrix.models_indexes) {
-                Model& model = models[model_index];
-                for (auto& vertex : model.vertices) {
-                    float vec[4] = {vertex.X, vertex.Y, vertex.Z, 1};
-                    matrix.transformPoint(vec);
-                    vertex.X = vec[0];
-                    vertex.Y = vec[1];
-                    vertex.Z = vec[2];
-                }
+        for (int model_index : matrix.models_indexes) {
+            if (matrix.steps(frame) != matrix.steps(models[model_index].frame) &&
+                std::find(moved.begin(), moved.end(), model_index) == moved.end()) {
+                moved.push_back(model_index);
             }
         }
     }
+    for (auto& model : models) model.frame = frame;
+    if (moved.empty()) return moved;
+
+    std::vector<Matrix> current(matrixes.size());
+    std::vector<int> order(matrixes.size());
+    for (size_t m = 0; m < matrixes.size(); m++) {
+        matrixes[m].evaluate(frame, current[m].data);
+        order[m] = (int)m;
+    }
+    // the keyframes starting on the same frame commute (see checkXML())
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return matrixes[a].frame < matrixes[b].frame; });
+    for (int model_index : moved) {
+        Model& model = models[model_index];
+        model.vertices = model.rest;
+        for (int m : order) {
+            const std::vector<int>& indexes = matrixes[m].models_indexes;
+            if (std::find(indexes.begin(), indexes.end(), model_index) == indexes.end()) continue;
+            for (auto& vertex : model.vertices) {
+                float vec[4] = {vertex.X, vertex.Y, vertex.Z, 1};
+                current[m].transformPoint(vec);
+                vertex.X = vec[0];
+                vertex.Y = vec[1];
+                vertex.Z = vec[2];
+            }
+        }
+    }
+    for (auto& m : current) delete[] m.data;
 
+    return moved;
 }
 
 void CornellBox(int frame, Scene& scene, std::vector<Model>& models, std::vector<Matrix>& matrixes) {
+    // Aplicação das transformações
+    std::vector<int> const moved = matrixesCheck(frame, matrixes, models);
+
+    // the scene persists across frames: only the transformed models are updated
+    if (scene.numPrimitives > 0) {
+        UpdateModels(scene, models, moved);
+        return;
+    }
+
     // Definição dos materiais
     int const text_backwall = AddTextMat(scene, "Dog.ppm", RGB(0.3, 0.3, 0.3), RGB(0.9, 0.9, 0.9), RGB(0., 0., 0.), RGB(0., 0., 0.));
     int const uminho_text = AddTextMat(scene, "UMinho.ppm", RGB(0.3, 0.3, 0.3), RGB(0.9, 0.9, 0.9), RGB(0., 0., 0.), RGB(0., 0., 0.));
@@ -173,101 +253,96 @@ void CornellBox(int frame, Scene& scene, std::vector<Model>& models, std::vector
     int const mirror_mat = AddMat(scene, RGB(0., 0., 0.), RGB(0., 0., 0.), RGB(0.9, 0.9, 0.9), RGB(0., 0., 0.));
     int const glass_mat = AddMat(scene, RGB(0., 0., 0.), RGB(0., 0., 0.), RGB(0.2, 0.2, 0.2), RGB(0.9, 0.9, 0.9), 1.2);
 
-    // Aplicação das transformações
-    matrixesCheck(frame, matrixes, models);
-
     // Floor
     Model& floor_model = models[0];
-    AddTriangle(scene, floor_model.vertices[0], floor_model.vertices[1], floor_model.vertices[2], white_mat);
-    AddTriangle(scene, floor_model.vertices[3], floor_model.vertices[4], floor_model.vertices[5], white_mat);
+    AddModelTriangle(scene, floor_model, 0, 1, 2, white_mat);
+    AddModelTriangle(scene, floor_model, 3, 4, 5, white_mat);
     
     // Ceiling
     Model& ceiling_model = models[1];
-    AddTriangle(scene, ceiling_model.vertices[0], ceiling_model.vertices[1], ceiling_model.vertices[2], white_mat);
-    AddTriangle(scene, ceiling_model.vertices[3], ceiling_model.vertices[4], ceiling_model.vertices[5], white_mat);
+    AddModelTriangle(scene, ceiling_model, 0, 1, 2, white_mat);
+    AddModelTriangle(scene, ceiling_model, 3, 4, 5, white_mat);
 
     // Back wall
     //AddTriangleUV (scene, Point(0.0, 0.0, 559.2), Point(549.6, 0.0, 559.2), Point(556.0, 548.8, 559.2), Vec2(1.,1.), Vec2(0.,1.), Vec2(0.,0.), text_backwall);
     //AddTriangleUV(scene, Point(0.0, 0.0, 559.2), Point(0.0, 548.8, 559.2), Point(556.0, 548.8, 559.2), Vec2(1.,1.), Vec2(1.,0.), Vec2(0.,0.), text_backwall);
     Model& back_wall_model = models[2];
-    AddTriangle(scene, back_wall_model.vertices[0], back_wall_model.vertices[1], back_wall_model.vertices[2], white_mat);
-    AddTriangle(scene, back_wall_model.vertices[3], back_wall_model.vertices[4], back_wall_model.vertices[5], white_mat);
+    AddModelTriangle(scene, back_wall_model, 0, 1, 2, white_mat);
+    AddModelTriangle(scene, back_wall_model, 3, 4, 5, white_mat);
 
     // Left Wall
     Model& left_wall_model = models[3];
-    AddTriangle(scene, left_wall_model.vertices[0], left_wall_model.vertices[1], left_wall_model.vertices[2], green_mat);
-    AddTriangle(scene, left_wall_model.vertices[3], left_wall_model.vertices[4], left_wall_model.vertices[5], green_mat);
+    AddModelTriangle(scene, left_wall_model, 0, 1, 2, green_mat);
+    AddModelTriangle(scene, left_wall_model, 3, 4, 5, green_mat);
 
     // Right Wall
     Model& right_wall_model = models[4];
-    AddTriangle(scene, right_wall_model.vertices[0], right_wall_model.vertices[1], right_wall_model.vertices[2], red_mat);
-    AddTriangle(scene, right_wall_model.vertices[3], right_wall_model.vertices[4], right_wall_model.vertices[5], red_mat);
+    AddModelTriangle(scene, right_wall_model, 0, 1, 2, red_mat);
+    AddModelTriangle(scene, right_wall_model, 3, 4, 5, red_mat);
 
     // Right Wall Mirror
     Model& right_wall_mirror_model = models[5];
-    AddTriangle(scene, right_wall_mirror_model.vertices[0], right_wall_mirror_model.vertices[1], right_wall_mirror_model.vertices[2], mirror_mat);
-    AddTriangle(scene, right_wall_mirror_model.vertices[3], right_wall_mirror_model.vertices[4], right_wall_mirror_model.vertices[5], mirror_mat);
+    AddModelTriangle(scene, right_wall_mirror_model, 0, 1, 2, mirror_mat);
+    AddModelTriangle(scene, right_wall_mirror_model, 3, 4, 5, mirror_mat);
     
     // short block
     Model& short_block_model = models[6];
     // top
     //AddTriangleUV(scene, Point(130.0, 165.0,  65.0), Point( 82.0, 165.0, 225.0), Point(240.0, 165.0, 272.0), Vec2(0.,0.), Vec2(0.,1.), Vec2(1.,1.), uminho_text);
     //AddTriangleUV(scene, Point(130.0, 165.0,  65.0), Point( 290.0, 165.0, 114.0), Point(240.0, 165.0, 272.0), Vec2(0.,0.), Vec2(1.,0.), Vec2(1.,1.), uminho_text);
-    AddTriangle(scene, short_block_model.vertices[0], short_block_model.vertices[1], short_block_model.vertices[2], orange_mat);
-    AddTriangle(scene, short_block_model.vertices[3], short_block_model.vertices[4], short_block_model.vertices[5], orange_mat);
+    AddModelTriangle(scene, short_block_model, 0, 1, 2, orange_mat);
+    AddModelTriangle(scene, short_block_model, 3, 4, 5, orange_mat);
 
     // bottom
-    AddTriangle(scene, short_block_model.vertices[6], short_block_model.vertices[7], short_block_model.vertices[8], orange_mat);
-    AddTriangle(scene, short_block_model.vertices[9], short_block_model.vertices[10], short_block_model.vertices[11], orange_mat);
+    AddModelTriangle(scene, short_block_model, 6, 7, 8, orange_mat);
+    AddModelTriangle(scene, short_block_model, 9, 10, 11, orange_mat);
 
     // left
-    AddTriangle(scene, short_block_model.vertices[12], short_block_model.vertices[13], short_block_model.vertices[14], orange_mat);
-    AddTriangle(scene, short_block_model.vertices[15], short_block_model.vertices[16], short_block_model.vertices[17], orange_mat);
+    AddModelTriangle(scene, short_block_model, 12, 13, 14, orange_mat);
+    AddModelTriangle(scene, short_block_model, 15, 16, 17, orange_mat);
 
     // back
-    AddTriangle(scene, short_block_model.vertices[18], short_block_model.vertices[19], short_block_model.vertices[20], orange_mat);
-    AddTriangle(scene, short_block_model.vertices[21], short_block_model.vertices[22], short_block_model.vertices[23], orange_mat);
+    AddModelTriangle(scene, short_block_model, 18, 19, 20, orange_mat);
+    AddModelTriangle(scene, short_block_model, 21, 22, 23, orange_mat);
 
     // right
-    AddTriangle(scene, short_block_model.vertices[24], short_block_model.vertices[25], short_block_model.vertices[26], orange_mat);
-    AddTriangle(scene, short_block_model.vertices[27], short_block_model.vertices[28], short_block_model.vertices[29], orange_mat);
+    AddModelTriangle(scene, short_block_model, 24, 25, 26, orange_mat);
+    AddModelTriangle(scene, short_block_model, 27, 28, 29, orange_mat);
     
     // front
-    AddTriangle(scene, short_block_model.vertices[30], short_block_model.vertices[31], short_block_model.vertices[32], orange_mat);
-    AddTriangle(scene, short_block_model.vertices[33], short_block_model.vertices[34], short_block_model.vertices[35], orange_mat);
+    AddModelTriangle(scene, short_block_model, 30, 31, 32, orange_mat);
+    AddModelTriangle(scene, short_block_model, 33, 34, 35, orange_mat);
 
     // tall block
     Model& tall_block_model = models[7];
     // top
-    AddTriangle(scene, tall_block_model.vertices[0], tall_block_model.vertices[1], tall_block_model.vertices[2], blue_mat);
-    AddTriangle(scene, tall_block_model.vertices[3], tall_block_model.vertices[4], tall_block_model.vertices[5], blue_mat);
+    AddModelTriangle(scene, tall_block_model, 0, 1, 2, blue_mat);
+    AddModelTriangle(scene, tall_block_model, 3, 4, 5, blue_mat);
 
     // bottom
-    AddTriangle(scene, tall_block_model.vertices[6], tall_block_model.vertices[7], tall_block_model.vertices[8], blue_mat);
-    AddTriangle(scene, tall_block_model.vertices[9], tall_block_model.vertices[10], tall_block_model.vertices[11], blue_mat);
+    AddModelTriangle(scene, tall_block_model, 6, 7, 8, blue_mat);
+    AddModelTriangle(scene, tall_block_model, 9, 10, 11, blue_mat);
 
     // left
-    AddTriangle(scene, tall_block_model.vertices[12], tall_block_model.vertices[13], tall_block_model.vertices[14], blue_mat);
-    AddTriangle(scene, tall_block_model.vertices[15], tall_block_model.vertices[16], tall_block_model.vertices[17], blue_mat);
+    AddModelTriangle(scene, tall_block_model, 12, 13, 14, blue_mat);
+    AddModelTriangle(scene, tall_block_model, 15, 16, 17, blue_mat);
 
     // back
-    AddTriangle(scene, tall_block_model.vertices[18], tall_block_model.vertices[19], tall_block_model.vertices[20], blue_mat);
-    AddTriangle(scene, tall_block_model.vertices[21], tall_block_model.vertices[22], tall_block_model.vertices[23], blue_mat);
+    AddModelTriangle(scene, tall_block_model, 18, 19, 20, blue_mat);
+    AddModelTriangle(scene, tall_block_model, 21, 22, 23, blue_mat);
 
     // right
-    AddTriangle(scene, tall_block_model.vertices[24], tall_block_model.vertices[25], tall_block_model.vertices[26], blue_mat);
-    AddTriangle(scene, tall_block_model.vertices[27], tall_block_model.vertices[28], tall_block_model.vertices[29], blue_mat);
+    AddModelTriangle(scene, tall_block_model, 24, 25, 26, blue_mat);
+    AddModelTriangle(scene, tall_block_model, 27, 28, 29, blue_mat);
     
     // front
-    AddTriangle(scene, tall_block_model.vertices[30], tall_block_model.vertices[31], tall_block_model.vertices[32], blue_mat);
-    AddTriangle(scene, tall_block_model.vertices[33], tall_block_model.vertices[34], tall_block_model.vertices[35], blue_mat);
+    AddModelTriangle(scene, tall_block_model, 30, 31, 32, blue_mat);
+    AddModelTriangle(scene, tall_block_model, 33, 34, 35, blue_mat);
     
     // transparent sphere
 
     Model& sphere_model = models[8];
-    Point center = sphere_model.vertices[0];
-    double radius = sphere_model.radius;
-    AddSphere(scene, center, radius, glass_mat);
+    AddModelSphere(scene, sphere_model, glass_mat);
 
     //AddSphere(scene, sphere_model.vertices[0], sphere_model.radius, glass_mat);
 
@@ -548,6 +623,15 @@ void DeFocusTriScene (Scene& scene) {
 }
 
 void EnvScene(int frame, Scene& scene, std::vector<Model>& models, std::vector<Matrix>& matrixes){
+    // Aplicação das transformações
+    std::vector<int> const moved = matrixesCheck(frame, matrixes, models);
+
+    // the scene persists across frames: only the transformed models are updated
+    if (scene.numPrimitives > 0) {
+        UpdateModels(scene, models, moved);
+        return;
+    }
+
     int const white_mat = AddMat(scene, RGB (0.1, 0.1, 0.1), RGB (0.6, 0.6, 0.6), RGB (0., 0., 0.), RGB (0., 0., 0.));
     int const red_mat = AddMat(scene, RGB (0.9, 0., 0.), RGB (0.4, 0., 0.), RGB (0., 0., 0.), RGB (0., 0., 0.));
     int const glass_mat = AddMat(scene, RGB (0., 0., 0.), RGB (0., 0., 0.), RGB (0.2, 0.2, 0.2), RGB (0.9, 0.9, 0.9), 1.2);
@@ -555,34 +639,31 @@ void EnvScene(int frame, Scene& scene, std::vector<Model>& models, std::vector<M
     int const green_mat = AddDiffuseMat(scene, RGB (0.1, 0.9, 0.1));
     int const orange_mat = AddMat(scene, RGB (0.37, 0.24, 0.), RGB (0.66, 0.44, 0.), RGB (0., 0., 0.), RGB (0., 0., 0.));
 
-    // Aplicação das transformações
-    matrixesCheck(frame, matrixes, models);
-
     // Piso
     Model& plane = models[0];
-    AddTriangle(scene, plane.vertices[0], plane.vertices[1], plane.vertices[2], white_mat);
-    AddTriangle(scene, plane.vertices[3], plane.vertices[0], plane.vertices[2], white_mat);
+    AddModelTriangle(scene, plane, 0, 1, 2, white_mat);
+    AddModelTriangle(scene, plane, 3, 0, 2, white_mat);
     //AddTriangle(scene, Point(600, 0.0, 0.0), Point(-100.0, 0.0, 0.0), Point(-100.0, 0.0, 800.0), white_mat);
     //AddTriangle(scene, Point(600, 0.0, 800.0), Point(600, 0.0, 0.0), Point(-100.0, 0.0, 800.0), white_mat);
 
     // Esfera grande de vidro
     Model& sphere1 = models[1];
-    AddSphere(scene, sphere1.vertices[0], sphere1.radius, glass_mat);
+    AddModelSphere(scene, sphere1, glass_mat);
     //AddSphere(scene, Point(278., 100., 250.), 100., glass_mat);
 
     // Esfera vermelha à esquerda
     Model& sphere2 = models[2];
-    AddSphere(scene, sphere2.vertices[0], sphere2.radius, red_mat);
+    AddModelSphere(scene, sphere2, red_mat);
     //AddSphere(scene, Point(90., 60., 380.), 60., red_mat);
 
     // Esfera reflexiva à direita
     Model& sphere3 = models[3];
-    AddSphere(scene, sphere3.vertices[0], sphere3.radius, mirror_mat);
+    AddModelSphere(scene, sphere3, mirror_mat);
     //AddSphere(scene, Point(400., 60., 380.), 60., mirror_mat); 
 
     // Esfera difusa ao fundo
     Model& sphere4 = models[4];
-    AddSphere(scene, sphere4.vertices[0], sphere4.radius, green_mat);
+    AddModelSphere(scene, sphere4, green_mat);
     //AddSphere(scene, Point(60., 50., 100.), 50., green_mat);
 
 
@@ -0,0 +1,351 @@
+//
+//  LightBVH.cpp
+//  VI-RT-V4-PathTracing
+//
+//  hierarchy over the scene's light sources
+//  based on pbrt 4th edition, sec 12.6.3 (BVHLightSampler) (pbrt.org)
+//
+
+#include "LightBVH.hpp"
+#include "AreaLight.hpp"
+#include "PointLight.hpp"
+#include <algorithm>
+#include <math.h>
+
+static const float OneMinusEpsilon = 0.99999994f;
+
+static inline float SafeSqrt (const float x) { return sqrtf(fmaxf(0.f, x)); }
+static inline float SafeACos (const float x) { return acosf(fminf(1.f, fmaxf(-1.f, x))); }
+static inline Vector Sub (const Point &a, const Point &b) { return Vector(a.X-b.X, a.Y-b.Y, a.Z-b.Z); }
+static inline float axisValue (const Vector &v, const int axis) {
+    return (axis==0 ? v.X : (axis==1 ? v.Y : v.Z));
+}
+
+// cos(max(0, a-b)) and sin(max(0, a-b)) from the sines and cosines of a and b
+// pbrt 4th edition, sec 12.6.1
+static inline float cosSubClamped (const float sin_a, const float cos_a, const float sin_b, const float cos_b) {
+    return (cos_a > cos_b ? 1.f : cos_a * cos_b + sin_a * sin_b);
+}
+static inline float sinSubClamped (const float sin_a, const float cos_a, const float sin_b, const float cos_b) {
+    return (cos_a > cos_b ? 0.f : sin_a * cos_b - cos_a * sin_b);
+}
+
+// rotation of v by theta radians around the (normalized) axis k (Rodrigues' formula)
+static Vector RotateAround (const Vector &v, const Vector &k, const float theta) {
+    const float c = cosf(theta), s = sinf(theta);
+    return v * c + k.cross(v) * s + k * (k.dot(v) * (1.f - c));
+}
+
+// pbrt 4th edition, sec 3.8.4, pag 114
+DirectionCone Union (const DirectionCone &a, const DirectionCone &b) {
+    if (a.IsEmpty()) return b;
+    if (b.IsEmpty()) return a;
+    const float theta_a = SafeACos(a.cosTheta), theta_b = SafeACos(b.cosTheta);
+    const float theta_d = SafeACos(a.w.dot(b.w));
+    // one of the cones includes the other
+    if (fminf(theta_d + theta_b, M_PI) <= theta_a) return a;
+    if (fminf(theta_d + theta_a, M_PI) <= theta_b) return b;
+    const float theta_o = (theta_a + theta_d + theta_b) / 2.f;
+    if (theta_o >= M_PI) return DirectionCone::EntireSphere();
+    // rotate a.w towards b.w such that the new cone includes both
+    Vector wr = a.w.cross(b.w);
+    if (wr.normSQ() == 0.f) return DirectionCone::EntireSphere();
+    wr.normalize();
+    const float theta_r = theta_o - theta_a;
+    Vector w = RotateAround(a.w, wr, theta_r);
+    w.normalize();
+    return DirectionCone(w, cosf(theta_o));
+}
+
+LightBounds Union (const LightBounds &a, const LightBounds &b) {
+    if (a.phi == 0.f) return b;
+    if (b.phi == 0.f) return a;
+    const DirectionCone cone = Union(DirectionCone(a.w, a.cosTheta_o), DirectionCone(b.w, b.cosTheta_o));
+    LightBounds lb;
+    lb.bounds = a.bounds;
+    lb.bounds.Union(b.bounds);
+    lb.w = cone.w;
+    lb.phi = a.phi + b.phi;
+    lb.cosTheta_o = cone.cosTheta;
+    lb.cosTheta_e = fminf(a.cosTheta_e, b.cosTheta_e);
+    lb.twoSided = a.twoSided || b.twoSided;
+    lb.Precompute();
+    return lb;
+}
+
+void LightBounds::Precompute (void) {
+    pc = bounds.Centroid();
+    radius = bounds.Diagonal().norm() / 2.f;
+    // pbrt clamps the squared distance to half the diagonal length
+    minD2 = radius;
+    sinTheta_o = SafeSqrt(1.f - cosTheta_o * cosTheta_o);
+}
+
+// pbrt 4th edition, sec 12.6.1, pag 792
+// the bounding sphere half angle (theta_b) is computed from radius / distance
+float LightBounds::Importance (const Point &p, const Vector &n) const {
+    const Vector d = Sub(p, pc);
+    const float dist2 = d.normSQ();
+    // clamp the distance to avoid huge values for points (almost) within the bounds
+    const float d2 = fmaxf(dist2, minD2);
+    const float invDist = (dist2 > 0.f ? 1.f / sqrtf(dist2) : 0.f);
+    const Vector wi = d * invDist;   // from the lights to p
+
+    // angle between the cone axis and wi
+    float cosTheta_w = w.dot(wi);
+    if (twoSided) cosTheta_w = fabsf(cosTheta_w);
+    const float sinTheta_w = SafeSqrt(1.f - cosTheta_w * cosTheta_w);
+
+    // half angle subtended by the bounds (their bounding sphere) as seen from p
+    float cosTheta_b, sinTheta_b;
+    if (dist2 < radius * radius) {
+        cosTheta_b = -1.f;
+        sinTheta_b = 0.f;
+    }
+    else {
+        sinTheta_b = radius * invDist;
+        cosTheta_b = SafeSqrt(1.f - sinTheta_b * sinTheta_b);
+    }
+
+    // minimum angle between the emitters' normals and wi
+    const float cosTheta_x = cosSubClamped(sinTheta_w, cosTheta_w, sinTheta_o, cosTheta_o);
+    const float sinTheta_x = sinSubClamped(sinTheta_w, cosTheta_w, sinTheta_o, cosTheta_o);
+    const float cosThetap = cosSubClamped(sinTheta_x, cosTheta_x, sinTheta_b, cosTheta_b);
+    if (cosThetap <= cosTheta_e) return 0.f;
+
+    float importance = phi * cosThetap / d2;
+
+    // incident cosine at p
+    if (n.normSQ() > 0.f) {
+        const float cosTheta_i = fabsf(wi.dot(n));
+        const float sinTheta_i = SafeSqrt(1.f - cosTheta_i * cosTheta_i);
+        importance *= cosSubClamped(sinTheta_i, cosTheta_i, sinTheta_b, cosTheta_b);
+    }
+    return fmaxf(importance, 0.f);
+}
+
+// bounds of the lights at finite distance ; false for ambient and environment lights
+static bool lightBounds (Light *l, LightBounds *lb) {
+    if (l->type == AREA_LIGHT) {
+        // one sided diffuse emitter: normals within a single direction,
+        // emission within PI/2 of the normal
+        const AreaLight *al = (AreaLight *)l;
+        lb->bounds = al->gem->bb;
+        lb->w = al->gem->normal;
+        lb->phi = l->Power();
+        lb->cosTheta_o = 1.f;
+        lb->cosTheta_e = 0.f;
+        lb->twoSided = false;
+        lb->Precompute();
+        return true;
+    }
+    if (l->type == POINT_LIGHT) {
+        // isotropic: emits in all directions
+        const PointLight *pl = (PointLight *)l;
+        lb->bounds.min = lb->bounds.max = pl->pos;
+        lb->w = Vector(0.f, 0.f, 1.f);
+        lb->phi = l->Power();
+        lb->cosTheta_o = -1.f;
+        lb->cosTheta_e = 0.f;
+        lb->twoSided = false;
+        lb->Precompute();
+        return true;
+    }
+    return false;
+}
+
+// surface area heuristic extended with the directional bounds
+// pbrt 4th edition, sec 12.6.3, pag 799
+static float EvaluateCost (const LightBounds &b, const BB &bounds, const int dim) {
+    const float theta_o = SafeACos(b.cosTheta_o), theta_e = SafeACos(b.cosTheta_e);
+    const float theta_w = fminf(theta_o + theta_e, M_PI);
+    const float sinTheta_o = SafeSqrt(1.f - b.cosTheta_o * b.cosTheta_o);
+    const float M_omega = 2.f * M_PI * (1.f - b.cosTheta_o) +
+        M_PI / 2.f * (2.f * theta_w * sinTheta_o - cosf(theta_o - 2.f * theta_w) -
+                      2.f * theta_o * sinTheta_o + b.cosTheta_o);
+    // penalize thin boxes
+    Vector d = bounds.Diagonal();
+    const float dDim = axisValue(d, dim);
+    const float Kr = (dDim > 0.f ? fmaxf(d.X, fmaxf(d.Y, d.Z)) / dDim : 1.f);
+    return b.phi * M_omega * Kr * b.bounds.SurfaceArea();
+}
+
+void LightBVH::Build (const std::vector<Light *> &lights) {
+    Clear();
+    bitTrails.assign(lights.size(), 0);
+    std::vector<std::pair<int, LightBounds> > bvhLights;
+    for (int l=0 ; l<(int)lights.size() ; l++) {
+        LightBounds lb;
+        if (!lightBounds(lights[l], &lb)) {
+            infiniteLights.push_back(l);
+            continue;
+        }
+        if (lb.phi > 0.f) bvhLights.push_back(std::make_pair(l, lb));
+    }
+    if (bvhLights.empty()) return;
+    nodes.reserve(2 * bvhLights.size() - 1);
+    LightBounds lb;
+    buildRecursive(bvhLights, 0, (int)bvhLights.size(), 0, 0, &lb);
+}
+
+// builds the sub tree over bvhLights[start..end[ and returns the index of its root
+// bitTrail holds the path from the root: bit i is set if the second child was taken at depth i
+int LightBVH::buildRecursive (std::vector<std::pair<int, LightBounds> > &bvhLights,
+                              const int start, const int end, const uint64_t bitTrail,
+                              const int depth, LightBounds *lb) {
+    if (end - start == 1) {
+        const int nodeIndex = (int)nodes.size();
+        LightBVHNode node;
+        node.lb = bvhLights[start].second;
+        node.childOrLightIndex = bvhLights[start].first;
+        node.isLeaf = 1;
+        nodes.push_back(node);
+        bitTrails[bvhLights[start].first] = bitTrail;
+        *lb = node.lb;
+        return nodeIndex;
+    }
+
+    BB bounds, centroidBounds;
+    bounds.setEmpty();
+    centroidBounds.setEmpty();
+    for (int i=start ; i<end ; i++) {
+        bounds.Union(bvhLights[i].second.bounds);
+        centroidBounds.update(bvhLights[i].second.Centroid());
+    }
+
+    // the split with the least cost, over 12 buckets per axis
+    const int nBuckets = 12;
+    float minCost = INFINITY;
+    int minBucket = -1, minDim = -1;
+    for (int dim=0 ; dim<3 ; dim++) {
+        const Vector cd = centroidBounds.Diagonal();
+        if (axisValue(cd, dim) <= 0.f) continue;
+        LightBounds bucketLightBounds[nBuckets];
+        for (int b=0 ; b<nBuckets ; b++) bucketLightBounds[b].phi = 0.f;
+        for (int i=start ; i<end ; i++) {
+            const Vector o = centroidBounds.Offset(bvhLights[i].second.Centroid());
+            int b = (int)(nBuckets * axisValue(o, dim));
+            if (b == nBuckets) b = nBuckets - 1;
+            bucketLightBounds[b] = Union(bucketLightBounds[b], bvhLights[i].second);
+        }
+        for (int i=0 ; i<nBuckets-1 ; i++) {
+            LightBounds b0, b1;
+            b0.phi = b1.phi = 0.f;
+            for (int j=0 ; j<=i ; j++) b0 = Union(b0, bucketLightBounds[j]);
+            for (int j=i+1 ; j<nBuckets ; j++) b1 = Union(b1, bucketLightBounds[j]);
+            const float cost = (b0.phi > 0.f ? EvaluateCost(b0, bounds, dim) : 0.f) +
+                               (b1.phi > 0.f ? EvaluateCost(b1, bounds, dim) : 0.f);
+            if (cost > 0.f && cost < minCost) {
+                minCost = cost;
+                minBucket = i;
+                minDim = dim;
+            }
+        }
+    }
+
+    int mid;
+    if (minDim == -1) mid = (start + end) / 2;
+    else {
+        const BB cb = centroidBounds;
+        const int dim = minDim, bucket = minBucket;
+        std::pair<int, LightBounds> *pmid = std::partition(&bvhLights[start], &bvhLights[end-1]+1,
+            [&](const std::pair<int, LightBounds> &l) {
+                int b = (int)(nBuckets * axisValue(cb.Offset(l.second.Centroid()), dim));
+                if (b == nBuckets) b = nBuckets - 1;
+                return b <= bucket;
+            });
+        mid = (int)(pmid - &bvhLights[0]);
+        if (mid == start || mid == end) mid = (start + end) / 2;
+    }
+
+    const int nodeIndex = (int)nodes.size();
+    nodes.push_back(LightBVHNode());
+    LightBounds lb0, lb1;
+    buildRecursive(bvhLights, start, mid, bitTrail, depth+1, &lb0);
+    const int second = buildRecursive(bvhLights, mid, end, bitTrail | ((uint64_t)1 << depth), depth+1, &lb1);
+    nodes[nodeIndex].lb = Union(lb0, lb1);
+    nodes[nodeIndex].childOrLightIndex = second;
+    nodes[nodeIndex].isLeaf = 0;
+    *lb = nodes[nodeIndex].lb;
+    return nodeIndex;
+}
+
+// probability of sampling the infinite lights instead of traversing the hierarchy
+float LightBVH::pInfinite (void) const {
+    const int nInfinite = (int)infiniteLights.size();
+    return (float)nInfinite / (float)(nInfinite + (nodes.empty() ? 0 : 1));
+}
+
+// at each interior node a child is selected proportionally to its importance
+// pbrt 4th edition, sec 12.6.3, pag 801
+int LightBVH::Sample (const Point &p, const Vector &n, float u, float *pmf) const {
+    const float pInf = pInfinite();
+    if (u < pInf) {
+        const int nInfinite = (int)infiniteLights.size();
+        u /= pInf;
+        const int index = std::min((int)(u * nInfinite), nInfinite - 1);
+        *pmf = pInf / nInfinite;
+        return infiniteLights[index];
+    }
+    if (nodes.empty()) return -1;
+
+    u = fminf((u - pInf) / (1.f - pInf), OneMinusEpsilon);
+    int nodeIndex = 0;
+    float nodePMF = 1.f - pInf;
+    while (true) {
+        const LightBVHNode &node = nodes[nodeIndex];
+        if (node.isLeaf) {
+            if (nodeIndex > 0 || node.lb.Importance(p, n) > 0.f) {
+                *pmf = nodePMF;
+                return node.childOrLightIndex;
+            }
+            return -1;
+        }
+        const float ci0 = nodes[nodeIndex+1].lb.Importance(p, n);
+        const float ci1 = nodes[node.childOrLightIndex].lb.Importance(p, n);
+        if (ci0 == 0.f && ci1 == 0.f) return -1;
+        const float p0 = ci0 / (ci0 + ci1);
+        if (u < p0) {
+            nodeIndex = nodeIndex + 1;
+            u = fminf(u / p0, OneMinusEpsilon);
+            nodePMF *= p0;
+        }
+        else {
+            nodeIndex = node.childOrLightIndex;
+            u = fminf((u - p0) / (1.f - p0), OneMinusEpsilon);
+            nodePMF *= 1.f - p0;
+        }
+    }
+}
+
+// follows the light's bit trail from the root, multiplying the probabilities of the children taken
+// pbrt 4th edition, sec 12.6.3, pag 802
+float LightBVH::PMF (const Point &p, const Vector &n, const int l_ndx) const {
+    for (int i=0 ; i<(int)infiniteLights.size() ; i++) {
+        if (infiniteLights[i] == l_ndx) return pInfinite() / infiniteLights.size();
+    }
+    if (nodes.empty()) return 0.f;
+    uint64_t bitTrail = bitTrails[l_ndx];
+    float pmf = 1.f - pInfinite();
+    int nodeIndex = 0;
+    while (true) {
+        const LightBVHNode &node = nodes[nodeIndex];
+        if (node.isLeaf) {
+            // as in Sample(): a single light at the root is not selected if it can not contribute
+            if (node.childOrLightIndex != l_ndx || (nodeIndex == 0 && node.lb.Importance(p, n) == 0.f)) return 0.f;
+            return pmf;
+        }
+        const float ci0 = nodes[nodeIndex+1].lb.Importance(p, n);
+        const float ci1 = nodes[node.childOrLightIndex].lb.Importance(p, n);
+        if (ci0 == 0.f && ci1 == 0.f) return 0.f;
+        if (bitTrail & 1) {
+            pmf *= ci1 / (ci0 + ci1);
+            nodeIndex = node.childOrLightIndex;
+        }
+        else {
+            pmf *= ci0 / (ci0 + ci1);
+            nodeIndex = nodeIndex + 1;
+        }
+        bitTrail >>= 1;
+    }
+}
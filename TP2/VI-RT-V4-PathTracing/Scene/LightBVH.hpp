@@ -0,0 +1,85 @@
+//
+//  LightBVH.hpp
+//  VI-RT-V4-PathTracing
+//
+//  hierarchy over the scene's light sources used to select one light per
+//  shading point with probability proportional to an estimate of its
+//  contribution, accounting for power, distance and orientation
+//  based on pbrt 4th edition, sec 12.6.3 (BVHLightSampler) (pbrt.org)
+//
+
+#ifndef LightBVH_hpp
+#define LightBVH_hpp
+
+#include <vector>
+#include <stdint.h>
+#include "BB.hpp"
+#include "light.hpp"
+
+// set of directions: the cone around w with half angle acos(cosTheta)
+// pbrt 4th edition, sec 3.8.4
+typedef struct DirectionCone {
+    Vector w;
+    float cosTheta;
+    DirectionCone (): w(0.f, 0.f, 1.f), cosTheta(INFINITY) {}   // empty
+    DirectionCone (const Vector &_w, const float _cosTheta): w(_w), cosTheta(_cosTheta) {}
+    bool IsEmpty (void) const { return cosTheta == INFINITY; }
+    static DirectionCone EntireSphere (void) { return DirectionCone(Vector(0.f, 0.f, 1.f), -1.f); }
+} DirectionCone;
+
+// the smallest cone that includes both a and b
+DirectionCone Union (const DirectionCone &a, const DirectionCone &b);
+
+// spatial and directional bounds of the emission of one (or many) lights
+// pbrt 4th edition, sec 12.6.1
+typedef struct LightBounds {
+    BB bounds;          // emitting points
+    Vector w;           // normals are within acos(cosTheta_o) of w
+    float phi;          // emitted power
+    float cosTheta_o;
+    float cosTheta_e;   // emission is within acos(cosTheta_e) of each normal
+    bool twoSided;
+    // constants used by Importance() (see Precompute())
+    Point pc;           // bounds centroid
+    float radius;       // radius of the bounding sphere (centered at pc)
+    float minD2;        // lower bound of the squared distance to the lights
+    float sinTheta_o;
+
+    Point Centroid (void) const { return bounds.Centroid(); }
+    // must be called after setting (or changing) the members above
+    void Precompute (void);
+    // conservative estimate of the contribution at point p, with normal n
+    // (n null if the receiving surface orientation must be ignored)
+    float Importance (const Point &p, const Vector &n) const;
+} LightBounds;
+
+LightBounds Union (const LightBounds &a, const LightBounds &b);
+
+// nodes are stored depth first: the first child of an interior node is the next node
+typedef struct LightBVHNode {
+    LightBounds lb;
+    int childOrLightIndex;   // leaf: index on Scene::lights ; interior: second child
+    int isLeaf;
+} LightBVHNode;
+
+class LightBVH {
+    std::vector<LightBVHNode> nodes;
+    std::vector<int> infiniteLights;   // lights without bounds (ambient, environment)
+    std::vector<uint64_t> bitTrails;   // per light: the path from the root (see PMF())
+    int buildRecursive (std::vector<std::pair<int, LightBounds> > &bvhLights,
+                        const int start, const int end, const uint64_t bitTrail,
+                        const int depth, LightBounds *lb);
+    float pInfinite (void) const;
+public:
+    void Build (const std::vector<Light *> &lights);
+    void Clear (void) { nodes.clear(); infiniteLights.clear(); bitTrails.clear(); }
+    // selects one light for the shading point p, with normal n, given u uniform in [0,1[
+    // returns its index on Scene::lights, or -1 if no light can contribute to p
+    // pmf is the probability of the returned light
+    int Sample (const Point &p, const Vector &n, float u, float *pmf) const;
+    // probability of Sample() returning light l_ndx at p
+    float PMF (const Point &p, const Vector &n, const int l_ndx) const;
+    int numNodes (void) const { return (int)nodes.size(); }
+};
+
+#endif /* LightBVH_hpp */
@@ -0,0 +1,78 @@
+//
+//  ShadowQueue.cpp
+//  VI-RT-V4-PathTracing
+//
+
+#include "ShadowQueue.hpp"
+#include "scene.hpp"
+#include "RayPacket.hpp"
+
+void ShadowQueue::resize (const int n) {
+    order.resize(n);
+    bucket.resize(n);
+    target.resize(n);
+    light.resize(n);
+    o.resize(n);
+    dir.resize(n);
+    maxL.resize(n);
+    contribution.resize(n);
+    visible.resize(n);
+}
+
+// the requests are sorted with a stable counting sort on (light, direction octant):
+// within a bucket they keep the order they were added in, which for the
+// wavefront renderer is the order of their pixels, hence their origins are
+// close together as well ; rays with the same signs form coherent packets (see RayPacket)
+static inline int Octant (const Vector &dir) {
+    return (dir.X < 0.f) | ((dir.Y < 0.f) << 1) | ((dir.Z < 0.f) << 2);
+}
+
+void ShadowQueue::Trace (Scene *scene) {
+    int nBuckets = 0;
+    for (int j = 0; j < size; j++) {
+        bucket[j] = light[j] * 8 + Octant(dir[j]);
+        if (bucket[j] >= nBuckets) nBuckets = bucket[j] + 1;
+    }
+    std::vector<int> first(nBuckets + 1, 0);
+    for (int j = 0; j < size; j++) first[bucket[j] + 1]++;
+    for (int b = 0; b < nBuckets; b++) first[b + 1] += first[b];
+    for (int j = 0; j < size; j++) order[first[bucket[j]]++] = j;
+
+    if (!packets) {
+        #pragma omp parallel for schedule(dynamic, 64)
+        for (int k = 0; k < size; k++) {
+            const int j = order[k];
+            visible[j] = scene->visibility(Ray(o[j], dir[j], SHADOW), maxL[j]);
+        }
+        return;
+    }
+
+    // packets of up to RayPacket::maxSize consecutive requests of the same bucket
+    std::vector<int> start;
+    for (int j = 0; j < size; j++) {
+        if (start.empty() || j - start.back() == RayPacket::maxSize ||
+            bucket[order[j]] != bucket[order[start.back()]]) {
+            start.push_back(j);
+        }
+    }
+    const int nPackets = (int)start.size();
+    start.push_back(size);
+
+    #pragma omp parallel for schedule(dynamic, 16)
+    for (int b = 0; b < nPackets; b++) {
+        RayPacket p;
+        float pMaxL[RayPacket::maxSize];
+        bool pVisible[RayPacket::maxSize];
+        p.size = start[b+1] - start[b];
+        for (int k = 0; k < p.size; k++) {
+            const int j = order[start[b] + k];
+            p.r[k] = Ray(o[j], dir[j], SHADOW);
+            pMaxL[k] = maxL[j];
+        }
+        p.ComputeBounds();
+        scene->visibilityPacket(p, pMaxL, pVisible);
+        for (int k = 0; k < p.size; k++) {
+            visible[order[start[b] + k]] = pVisible[k];
+        }
+    }
+}
@@ -0,0 +1,59 @@
+//
+//  ShadowQueue.hpp
+//  VI-RT-V4-PathTracing
+//
+//  shadow rays whose occlusion is resolved in a batch, after all of them have
+//  been generated: the requests are sorted by light and by direction (octant)
+//  such that consecutive ones are coherent, and traced one at a time ;
+//  tracing them in packets is optional (see packets)
+//  the caller adds contribution[j] to target[j] if visible[j]
+//  based on the shadow ray queue of pbrt 4th edition, sec 15.1 and 15.3.1
+//
+
+#ifndef ShadowQueue_hpp
+#define ShadowQueue_hpp
+
+#include <vector>
+#include <stdint.h>
+#include "ray.hpp"
+#include "RGB.hpp"
+
+class Scene;
+
+class ShadowQueue {
+    std::vector<int> bucket;   // light and direction octant of each request
+    std::vector<int> order;    // the requests sorted by bucket (see Trace())
+public:
+    int size;
+    std::vector<int> target;          // e.g., the path the contribution belongs to
+    std::vector<int> light;           // index on Scene::lights
+    std::vector<Point> o;
+    std::vector<Vector> dir;
+    std::vector<float> maxL;          // occluders are searched up to maxL along the ray
+    std::vector<RGB> contribution;    // if the ray is not occluded
+    std::vector<char> visible;        // set by Trace()
+
+    // packets: trace the sorted requests in packets rather than one at a time ;
+    // this only pays off if consecutive requests are coherent (shared BVH nodes),
+    // e.g., close origins and a point light
+    bool packets;
+
+    ShadowQueue (const bool _packets=false): size(0), packets(_packets) {}
+    // room for n requests
+    void resize (const int n);
+    void clear (void) { size = 0; }
+    // appends a request ; there must be room for it (see resize())
+    void Add (const Ray &shadow, const float _maxL, const RGB &_contribution, const int _light, const int _target) {
+        const int j = size++;
+        target[j] = _target;
+        light[j] = _light;
+        o[j] = shadow.o;
+        dir[j] = shadow.dir;
+        maxL[j] = _maxL;
+        contribution[j] = _contribution;
+    }
+    // sorts the requests and sets visible for all of them, in parallel (OpenMP)
+    void Trace (Scene *scene);
+};
+
+#endif /* ShadowQueue_hpp */
@@ -0,0 +1,210 @@
+//
+//  TriangleBlock.cpp
+//  VI-RT-V4-PathTracing
+//
+//  packed Moller Trumbore intersection
+//  https://en.wikipedia.org/wiki/M%C3%B6ller%E2%80%93Trumbore_intersection_algorithm
+//
+
+#include "TriangleBlock.hpp"
+#include <math.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TRIANGLE_BLOCK_SIMD
+#include <immintrin.h>
+#endif
+
+void TriangleBlock::clear (void) {
+    for (int l=0 ; l<width ; l++) {
+        v1X[l] = v1Y[l] = v1Z[l] = 0.f;
+        e1X[l] = e1Y[l] = e1Z[l] = 0.f;
+        e2X[l] = e2Y[l] = e2Z[l] = 0.f;
+        nX[l] = nY[l] = nZ[l] = 0.f;
+        cull[l] = 0.f;
+        occluder[l] = 0.f;
+        item[l] = -1;
+    }
+}
+
+void TriangleBlock::set (const int l, const Triangle *t, const int _item, const bool isOccluder) {
+    v1X[l] = t->v1.X; v1Y[l] = t->v1.Y; v1Z[l] = t->v1.Z;
+    e1X[l] = t->edge1.X; e1Y[l] = t->edge1.Y; e1Z[l] = t->edge1.Z;
+    e2X[l] = t->edge2.X; e2Y[l] = t->edge2.Y; e2Z[l] = t->edge2.Z;
+    nX[l] = t->normal.X; nY[l] = t->normal.Y; nZ[l] = t->normal.Z;
+    cull[l] = (t->BackFaceCulling ? 1.f : 0.f);
+    occluder[l] = (isOccluder ? 1.f : 0.f);
+    item[l] = _item;
+}
+
+#ifdef TRIANGLE_BLOCK_SIMD
+
+// 4 lanes starting at lane k ; returns the mask of valid hits in ]EPSILON, tMax[
+static inline int mt4 (const TriangleBlock &b, const int k, const Ray &r, const float tMax,
+                       float t[4], float uu[4], float vv[4]) {
+    const __m128 dX = _mm_set1_ps(r.dir.X), dY = _mm_set1_ps(r.dir.Y), dZ = _mm_set1_ps(r.dir.Z);
+    const __m128 eps = _mm_set1_ps(EPSILON);
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.f);
+
+    // reject rays parallel to the triangle or hitting culled back faces
+    const __m128 par = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(b.nX+k), dX),
+                                             _mm_mul_ps(_mm_load_ps(b.nY+k), dY)),
+                                  _mm_mul_ps(_mm_load_ps(b.nZ+k), dZ));
+    const __m128 absPar = _mm_andnot_ps(_mm_set1_ps(-0.f), par);
+    const __m128 culled = _mm_cmpneq_ps(_mm_load_ps(b.cull+k), zero);
+    __m128 valid = _mm_or_ps(_mm_and_ps(culled, _mm_cmple_ps(par, _mm_sub_ps(zero, eps))),
+                             _mm_andnot_ps(culled, _mm_cmpge_ps(absPar, eps)));
+
+    const __m128 e1X = _mm_load_ps(b.e1X+k), e1Y = _mm_load_ps(b.e1Y+k), e1Z = _mm_load_ps(b.e1Z+k);
+    const __m128 e2X = _mm_load_ps(b.e2X+k), e2Y = _mm_load_ps(b.e2Y+k), e2Z = _mm_load_ps(b.e2Z+k);
+    // h = dir x edge2
+    const __m128 hX = _mm_sub_ps(_mm_mul_ps(dY, e2Z), _mm_mul_ps(dZ, e2Y));
+    const __m128 hY = _mm_sub_ps(_mm_mul_ps(dZ, e2X), _mm_mul_ps(dX, e2Z));
+    const __m128 hZ = _mm_sub_ps(_mm_mul_ps(dX, e2Y), _mm_mul_ps(dY, e2X));
+    const __m128 a = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1X, hX), _mm_mul_ps(e1Y, hY)), _mm_mul_ps(e1Z, hZ));
+    const __m128 ff = _mm_div_ps(one, a);
+    // s = o - v1
+    const __m128 sX = _mm_sub_ps(_mm_set1_ps(r.o.X), _mm_load_ps(b.v1X+k));
+    const __m128 sY = _mm_sub_ps(_mm_set1_ps(r.o.Y), _mm_load_ps(b.v1Y+k));
+    const __m128 sZ = _mm_sub_ps(_mm_set1_ps(r.o.Z), _mm_load_ps(b.v1Z+k));
+    const __m128 u = _mm_mul_ps(ff, _mm_add_ps(_mm_add_ps(_mm_mul_ps(sX, hX), _mm_mul_ps(sY, hY)), _mm_mul_ps(sZ, hZ)));
+    valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmple_ps(u, one)));
+    // q = s x edge1
+    const __m128 qX = _mm_sub_ps(_mm_mul_ps(sY, e1Z), _mm_mul_ps(sZ, e1Y));
+    const __m128 qY = _mm_sub_ps(_mm_mul_ps(sZ, e1X), _mm_mul_ps(sX, e1Z));
+    const __m128 qZ = _mm_sub_ps(_mm_mul_ps(sX, e1Y), _mm_mul_ps(sY, e1X));
+    const __m128 v = _mm_mul_ps(ff, _mm_add_ps(_mm_add_ps(_mm_mul_ps(dX, qX), _mm_mul_ps(dY, qY)), _mm_mul_ps(dZ, qZ)));
+    valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmple_ps(_mm_add_ps(u, v), one)));
+    const __m128 tt = _mm_mul_ps(ff, _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2X, qX), _mm_mul_ps(e2Y, qY)), _mm_mul_ps(e2Z, qZ)));
+    valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpgt_ps(tt, eps), _mm_cmplt_ps(tt, _mm_set1_ps(tMax))));
+    _mm_storeu_ps(t, tt);
+    _mm_storeu_ps(uu, u);
+    _mm_storeu_ps(vv, v);
+    return _mm_movemask_ps(valid);
+}
+
+// 8 lanes ; same computation as mt4()
+__attribute__((target("avx2")))
+static inline int mt8 (const TriangleBlock &b, const Ray &r, const float tMax,
+                       float t[8], float uu[8], float vv[8]) {
+    const __m256 dX = _mm256_set1_ps(r.dir.X), dY = _mm256_set1_ps(r.dir.Y), dZ = _mm256_set1_ps(r.dir.Z);
+    const __m256 eps = _mm256_set1_ps(EPSILON);
+    const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.f);
+
+    const __m256 par = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_load_ps(b.nX), dX),
+                                                   _mm256_mul_ps(_mm256_load_ps(b.nY), dY)),
+                                     _mm256_mul_ps(_mm256_load_ps(b.nZ), dZ));
+    const __m256 absPar = _mm256_andnot_ps(_mm256_set1_ps(-0.f), par);
+    const __m256 culled = _mm256_cmp_ps(_mm256_load_ps(b.cull), zero, _CMP_NEQ_UQ);
+    __m256 valid = _mm256_or_ps(_mm256_and_ps(culled, _mm256_cmp_ps(par, _mm256_sub_ps(zero, eps), _CMP_LE_OQ)),
+                                _mm256_andnot_ps(culled, _mm256_cmp_ps(absPar, eps, _CMP_GE_OQ)));
+
+    const __m256 e1X = _mm256_load_ps(b.e1X), e1Y = _mm256_load_ps(b.e1Y), e1Z = _mm256_load_ps(b.e1Z);
+    const __m256 e2X = _mm256_load_ps(b.e2X), e2Y = _mm256_load_ps(b.e2Y), e2Z = _mm256_load_ps(b.e2Z);
+    const __m256 hX = _mm256_sub_ps(_mm256_mul_ps(dY, e2Z), _mm256_mul_ps(dZ, e2Y));
+    const __m256 hY = _mm256_sub_ps(_mm256_mul_ps(dZ, e2X), _mm256_mul_ps(dX, e2Z));
+    const __m256 hZ = _mm256_sub_ps(_mm256_mul_ps(dX, e2Y), _mm256_mul_ps(dY, e2X));
+    const __m256 a = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1X, hX), _mm256_mul_ps(e1Y, hY)), _mm256_mul_ps(e1Z, hZ));
+    const __m256 ff = _mm256_div_ps(one, a);
+    const __m256 sX = _mm256_sub_ps(_mm256_set1_ps(r.o.X), _mm256_load_ps(b.v1X));
+    const __m256 sY = _mm256_sub_ps(_mm256_set1_ps(r.o.Y), _mm256_load_ps(b.v1Y));
+    const __m256 sZ = _mm256_sub_ps(_mm256_set1_ps(r.o.Z), _mm256_load_ps(b.v1Z));
+    const __m256 u = _mm256_mul_ps(ff, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sX, hX), _mm256_mul_ps(sY, hY)), _mm256_mul_ps(sZ, hZ)));
+    valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ), _mm256_cmp_ps(u, one, _CMP_LE_OQ)));
+    const __m256 qX = _mm256_sub_ps(_mm256_mul_ps(sY, e1Z), _mm256_mul_ps(sZ, e1Y));
+    const __m256 qY = _mm256_sub_ps(_mm256_mul_ps(sZ, e1X), _mm256_mul_ps(sX, e1Z));
+    const __m256 qZ = _mm256_sub_ps(_mm256_mul_ps(sX, e1Y), _mm256_mul_ps(sY, e1X));
+    const __m256 v = _mm256_mul_ps(ff, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dX, qX), _mm256_mul_ps(dY, qY)), _mm256_mul_ps(dZ, qZ)));
+    valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(v, zero, _CMP_GE_OQ),
+                                               _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ)));
+    const __m256 tt = _mm256_mul_ps(ff, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2X, qX), _mm256_mul_ps(e2Y, qY)), _mm256_mul_ps(e2Z, qZ)));
+    valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(tt, eps, _CMP_GT_OQ),
+                                               _mm256_cmp_ps(tt, _mm256_set1_ps(tMax), _CMP_LT_OQ)));
+    _mm256_storeu_ps(t, tt);
+    _mm256_storeu_ps(uu, u);
+    _mm256_storeu_ps(vv, v);
+    return _mm256_movemask_ps(valid);
+}
+
+static int hits_sse (const TriangleBlock &b, const Ray &r, const float tMax,
+                     float t[8], float u[8], float v[8]) {
+    return mt4(b, 0, r, tMax, t, u, v) | (mt4(b, 4, r, tMax, t+4, u+4, v+4) << 4);
+}
+
+__attribute__((target("avx2")))
+static int hits_avx2 (const TriangleBlock &b, const Ray &r, const float tMax,
+                      float t[8], float u[8], float v[8]) {
+    return mt8(b, r, tMax, t, u, v);
+}
+
+#else
+
+// portable version of the SIMD kernels (see Triangle::intersect())
+static int hits_scalar (const TriangleBlock &b, const Ray &r, const float tMax,
+                        float t[8], float uu[8], float vv[8]) {
+    int mask = 0;
+    for (int l=0 ; l<TriangleBlock::width ; l++) {
+        const float par = b.nX[l]*r.dir.X + b.nY[l]*r.dir.Y + b.nZ[l]*r.dir.Z;
+        if ((b.cull[l]!=0.f && par > -EPSILON) || (b.cull[l]==0.f && fabsf(par) < EPSILON)) continue;
+        const Vector e1(b.e1X[l], b.e1Y[l], b.e1Z[l]), e2(b.e2X[l], b.e2Y[l], b.e2Z[l]);
+        const Vector h = r.dir.cross(e2);
+        const float ff = 1.f / e1.dot(h);
+        const Vector s(r.o.X - b.v1X[l], r.o.Y - b.v1Y[l], r.o.Z - b.v1Z[l]);
+        const float u = ff * s.dot(h);
+        if (u < 0.f || u > 1.f) continue;
+        const Vector q = s.cross(e1);
+        const float v = ff * r.dir.dot(q);
+        if (v < 0.f || u + v > 1.f) continue;
+        t[l] = ff * e2.dot(q);
+        uu[l] = u;
+        vv[l] = v;
+        if (t[l] > EPSILON && t[l] < tMax) mask |= 1 << l;
+    }
+    return mask;
+}
+
+#endif
+
+typedef int (*BlockHitsFn) (const TriangleBlock &, const Ray &, const float, float *, float *, float *);
+
+// select the kernel once, according to the running CPU
+static BlockHitsFn selectKernel (void) {
+#ifdef TRIANGLE_BLOCK_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return hits_avx2;
+    return hits_sse;
+#else
+    return hits_scalar;
+#endif
+}
+
+static const BlockHitsFn blockHits = selectKernel();
+
+bool IntersectTriangleBlock (const TriangleBlock &b, const Ray &r, HitRecord *hit) {
+    float t[TriangleBlock::width], u[TriangleBlock::width], v[TriangleBlock::width];
+    int mask = blockHits(b, r, hit->t, t, u, v);
+    int lane = -1;
+    while (mask) {
+        const int l = __builtin_ctz(mask);
+        mask &= mask - 1;
+        if (t[l] < hit->t) {
+            hit->t = t[l];
+            lane = l;
+        }
+    }
+    if (lane < 0) return false;
+    hit->item = b.item[lane];
+    hit->u = u[lane];
+    hit->v = v[lane];
+    return true;
+}
+
+bool OccludedTriangleBlock (const TriangleBlock &b, const Ray &r, const float tMax) {
+    float t[TriangleBlock::width], u[TriangleBlock::width], v[TriangleBlock::width];
+    int mask = blockHits(b, r, tMax, t, u, v);
+    while (mask) {
+        const int l = __builtin_ctz(mask);
+        mask &= mask - 1;
+        if (b.occluder[l] != 0.f) return true;
+    }
+    return false;
+}
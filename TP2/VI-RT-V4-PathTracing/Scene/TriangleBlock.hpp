@@ -0,0 +1,46 @@
+//
+//  TriangleBlock.hpp
+//  VI-RT-V4-PathTracing
+//
+//  packed storage for up to 8 triangles in SoA layout,
+//  intersected all at once with SSE (2 x 4 lanes) or AVX2 (8 lanes)
+//  the instruction set is selected at run time
+//  each array is 32 bytes, and a block is aligned on 32 bytes, such that the
+//  lanes are read with aligned loads ; blocks are stored in a TriangleBlocks
+//  vector (std::allocator does not honour the alignment in C++11)
+//
+
+#ifndef TriangleBlock_hpp
+#define TriangleBlock_hpp
+
+#include "triangle.hpp"
+#include "ray.hpp"
+#include "intersection.hpp"
+#include "AlignedAllocator.hpp"
+#include <vector>
+
+typedef struct alignas(32) TriangleBlock {
+    static const int width = 8;
+    float v1X[width], v1Y[width], v1Z[width];   // first vertex
+    float e1X[width], e1Y[width], e1Z[width];   // edge1 = v2 - v1
+    float e2X[width], e2Y[width], e2Z[width];   // edge2 = v3 - v1
+    float nX[width], nY[width], nZ[width];      // geometric normal (for culling)
+    float cull[width];       // 1 if back faces are culled ; 0 otherwise
+    float occluder[width];   // 1 if it blocks shadow rays (i.e., it is not a light source)
+    int item[width];         // index on BVH::items ; -1 for empty lanes
+
+    // empty lanes have a null normal, hence they are never intersected
+    void clear (void);
+    void set (const int lane, const Triangle *t, const int _item, const bool isOccluder);
+} TriangleBlock;
+
+typedef std::vector<TriangleBlock, AlignedAllocator<TriangleBlock, 32> > TriangleBlocks;
+
+// closest intersection in ]EPSILON, hit->t[
+// on success hit is updated with the distance, item and (u,v)
+// same tests as Triangle::hit()
+bool IntersectTriangleBlock (const TriangleBlock &b, const Ray &r, HitRecord *hit);
+// any intersection in ]EPSILON, tMax[ with a triangle that is an occluder
+bool OccludedTriangleBlock (const TriangleBlock &b, const Ray &r, const float tMax);
+
+#endif /* TriangleBlock_hpp */
@@ -16,8 +16,42 @@
 #include <vector>
 
 
+// surface attributes are computed for the closest intersection only
+void Scene::finalize (const Ray &r, const HitRecord &hit, Intersection *isect) {
+    BVHItem const &item = bvh.items[hit.item];
+    item.g->finalize(r, hit, isect);
+    if (item.light_ndx >= 0) {  // area light
+        isect->isLight = true;
+        isect->lightNdx = item.light_ndx;
+        isect->Le = lights[item.light_ndx]->L();
+    }
+    else {
+        isect->f = BRDFs[prims[item.prim_ndx]->material_ndx];
+    }
+}
+
+// the rays of a coherent packet share the BVH traversal (see BVH::IntersectPacket())
+// the others are traced one at a time
+void Scene::tracePacket (RayPacket &p, Intersection *isect, bool *intersected) {
+    if (!bvh.isBuilt() || !p.coherent) {
+        for (int k=0 ; k<p.size ; k++) intersected[k] = trace(p.r[k], &isect[k]);
+        return;
+    }
+    HitRecord hits[RayPacket::maxSize];
+    bvh.IntersectPacket(p, hits, intersected);
+    for (int k=0 ; k<p.size ; k++) {
+        const Ray &r = p.r[k];
+        isect[k].pix_x = r.pix_x;
+        isect[k].pix_y = r.pix_y;
+        isect[k].isLight = false;
+        isect[k].lightNdx = -1;
+        isect[k].r_type = r.rtype;
+        if (intersected[k]) finalize(r, hits[k], &isect[k]);
+    }
+}
+
 bool Scene::trace (Ray r, Intersection *isect) {
-    Intersection curr_isect;
+    HitRecord hit, curr_hit;
     bool intersection = false;    
     
     /*if (r.pix_x==320 && r.pix_y==240) {
@@ -25,58 +59,68 @@ bool Scene::trace (Ray r, Intersection *isect) {
         fflush(stderr);
     }*/
         
-    curr_isect.pix_x = isect->pix_x = r.pix_x;
-    curr_isect.pix_y = isect->pix_y = r.pix_y;
+    isect->pix_x = r.pix_x;
+    isect->pix_y = r.pix_y;
 
     if (numPrimitives==0) return false;
 
+    isect->isLight = false;
+    isect->lightNdx = -1;
+    isect->r_type = r.rtype;
+
+    if (bvh.isBuilt()) {
+        if (!bvh.Intersect(r, &hit)) return false;
+        finalize(r, hit, isect);
+        return true;
+    }
+
 #if 1
 
-    // iterate over all primitives
-    for (auto prim_itr = prims.begin() ; prim_itr != prims.end() ; prim_itr++) {
+    // iterate over all primitives and area lights, keeping only the closest
+    // hit record ; item is the index on prims, or -(index on lights + 1)
+    Geometry *closest = NULL;
+    hit.t = MAXFLOAT;
+    for (int i=0 ; i<(int)prims.size() ; i++) {
        /* if (r.pix_x==320 && r.pix_y==240) {
             fprintf (stderr, "Testing intersection\n");
             fflush(stderr);
         }*/
-        if ((*prim_itr)->g->intersect(r, &curr_isect)) {
-            if (!intersection) { // first intersection
-                intersection = true;
-                *isect = curr_isect;
-                isect->f = BRDFs[(*prim_itr)->material_ndx];
-            }
-            else if (curr_isect.depth < isect->depth) {
-                *isect = curr_isect;
-                isect->f = BRDFs[(*prim_itr)->material_ndx];
-            }
+        Geometry *g = prims[i]->g;
+        if (g->bb.intersect(r) && g->hit(r, hit.t, &curr_hit)) {
+            intersection = true;
+            hit = curr_hit;
+            hit.item = i;
+            closest = g;
         }
     }
-    isect->isLight = false;
 
     // now iterate over light sources and intersect with those that have geometry
-    for (auto l = lights.begin() ; l != lights.end() ; l++) {
-        if ((*l)->type == AREA_LIGHT) {
-            AreaLight *al = (AreaLight *)*l;
-            if (al->gem->intersect(r, &curr_isect)) {
-                if (!intersection) { // first intersection
-                    intersection = true;
-                    *isect = curr_isect;
-                    isect->isLight = true;
-                    //isect->Le = RGB(2.,2.,2.);
-                    isect->Le = al->L();
-                }
-                else if (curr_isect.depth < isect->depth) {
-                    *isect = curr_isect;
-                    isect->isLight = true;
-                    isect->Le = al->L();
-                    //isect->Le = RGB(2.,2.,2.);
-                }
+    for (int l=0 ; l<(int)lights.size() ; l++) {
+        if (lights[l]->type == AREA_LIGHT) {
+            Geometry *g = ((AreaLight *)lights[l])->gem;
+            if (g->bb.intersect(r) && g->hit(r, hit.t, &curr_hit)) {
+                intersection = true;
+                hit = curr_hit;
+                hit.item = -(l+1);
+                closest = g;
             }
         }
     }
-    isect->r_type = r.rtype;
+    if (intersection) {
+        closest->finalize(r, hit, isect);
+        if (hit.item < 0) {
+            isect->isLight = true;
+            isect->lightNdx = -hit.item-1;
+            isect->Le = lights[-hit.item-1]->L();
+        }
+        else {
+            isect->f = BRDFs[prims[hit.item]->material_ndx];
+        }
+    }
 
 #else 
 
+    Intersection curr_isect;
     Intersection local_isect;
     bool local_hit = false;
 
@@ -96,6 +140,7 @@ bool Scene::trace (Ray r, Intersection *isect) {
     }
 
     isect->isLight = false;
+    isect->lightNdx = -1;
 
     #pragma omp parallel for private(curr_isect) firstprivate(r) schedule(dynamic)
     for (int i = 0; i < lights.size(); i++) {
@@ -109,6 +154,7 @@ bool Scene::trace (Ray r, Intersection *isect) {
                         intersection = true;
                         *isect = thread_isect;
                         isect->isLight = true;
+                        isect->lightNdx = i;
                         isect->Le = al->L();
                     }
                 }
@@ -128,16 +174,17 @@ bool Scene::trace (Ray r, Intersection *isect) {
 // checks whether a point on a light source (distance maxL) is visible
 bool Scene::visibility (Ray s, const float maxL) {
     bool visible = true;
-    Intersection curr_isect;
     
     if (numPrimitives==0) return true;
+
+    if (bvh.isBuilt()) {
+        return !bvh.IntersectP(s, maxL);
+    }
     
     // iterate over all primitives while visible
     for (auto prim_itr = prims.begin() ; prim_itr != prims.end() && visible ; prim_itr++) {
-        if ((*prim_itr)->g->intersect(s, &curr_isect)) {
-            if (curr_isect.depth < maxL) {
-                visible = false;
-            }
+        if ((*prim_itr)->g->occluded(s, maxL)) {
+            visible = false;
         }
     }
     return visible;
@@ -176,7 +223,71 @@ bool Scene::visibility(Ray s, const float maxL) {
 
 #endif
 
+// coherent packets share the BVH traversal (see BVH::IntersectPacketP())
+void Scene::visibilityPacket (RayPacket &p, const float *maxL, bool *visible) {
+    if (!bvh.isBuilt() || !p.coherent) {
+        for (int k=0 ; k<p.size ; k++) visible[k] = visibility(p.r[k], maxL[k]);
+        return;
+    }
+    bool occluded[RayPacket::maxSize];
+    bvh.IntersectPacketP(p, maxL, occluded);
+    for (int k=0 ; k<p.size ; k++) visible[k] = !occluded[k];
+}
+
+void Scene::BuildAccel (void) {
+    std::vector<BVHItem> items;
+
+    for (int i=0 ; i<(int)prims.size() ; i++) {
+        BVHItem item = {prims[i]->g, i, -1};
+        items.push_back(item);
+    }
+    // area lights have geometry: add them to the same hierarchy
+    for (int l=0 ; l<(int)lights.size() ; l++) {
+        if (lights[l]->type == AREA_LIGHT) {
+            BVHItem item = {((AreaLight *)lights[l])->gem, -1, l};
+            items.push_back(item);
+        }
+    }
+    bvh.Build(items);
+    moved = false;
+    SetLights();
+}
+
+bool Scene::SetLights (void) {
+    std::vector<float> power(lights.size());
+    float sum = 0.f;
+    int nFinite = 0;
+    environmentLight = -1;
+    for (int l=0 ; l<(int)lights.size() ; l++) {
+        if (lights[l]->type == ENVIRONMENT_LIGHT) environmentLight = l;
+        power[l] = lights[l]->Power();
+        if (power[l] > 0.f) {
+            sum += power[l];
+            nFinite++;
+        }
+    }
+    const float avg = (nFinite > 0 ? sum / nFinite : 1.f);
+    for (int l=0 ; l<(int)lights.size() ; l++) {
+        if (power[l] <= 0.f) power[l] = avg;
+    }
+    lightDistribution.Build(power);
+    lightBVH.Build(lights);
+    return (numLights > 0);
+}
+
+void Scene::UpdateAccel (void) {
+    if (!bvh.isBuilt()) BuildAccel();
+    else if (moved) {
+        bvh.Refit();
+        moved = false;
+    }
+}
+
 void Scene::clear() {
+    bvh.Clear();
+    lightBVH.Clear();
+    moved = false;
+
     // Deleta as primitivas
     for (auto prim : prims) {
         delete prim;
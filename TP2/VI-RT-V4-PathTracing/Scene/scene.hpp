@@ -14,35 +14,73 @@
 #include "primitive.hpp"
 #include "light.hpp"
 #include "ray.hpp"
+#include "RayPacket.hpp"
 #include "intersection.hpp"
 #include "BRDF.hpp"
+#include "BVH.hpp"
+#include "AliasTable.hpp"
+#include "LightBVH.hpp"
 
 class Scene {
     std::vector <Primitive *> prims;
     std::vector <BRDF *> BRDFs;
+    BVH bvh;    // acceleration structure over prims and area lights
+    bool moved; // some primitives changed in place since the last UpdateAccel()
+    // sets the surface attributes of isect from the closest hit found by bvh
+    void finalize (const Ray &r, const HitRecord &hit, Intersection *isect);
 public:
     std::vector <Light *> lights;
     int numPrimitives, numLights, numBRDFs;
+    // selects lights proportionally to their power (see SetLights())
+    AliasTable lightDistribution;
+    // selects lights according to their contribution to a given point (see SetLights())
+    LightBVH lightBVH;
+    // index on lights of the environment light, -1 if there is none (see SetLights())
+    int environmentLight;
 
-    Scene (): numPrimitives(0), numLights(0), numBRDFs(0) {}
-    bool SetLights (void) { return true; };
+    Scene (): moved(false), numPrimitives(0), numLights(0), numBRDFs(0), environmentLight(-1) {}
+    // builds lightDistribution and lightBVH ; called by BuildAccel()
+    // lights without finite power (ambient, environment) get the average power
+    // both are read only afterwards, such that the rendering threads sample them
+    // concurrently without locking
+    bool SetLights (void);
+    // (re)builds the acceleration structure ; call after all primitives and lights are added
+    // while it is not built trace() and visibility() test every primitive
+    void BuildAccel (void);
+    // builds the acceleration structure if it is not built yet ; otherwise it is
+    // refitted if MovedPrimitives() was called (see BVH::Refit())
+    // primitives and lights must not be added or removed after the first call
+    void UpdateAccel (void);
+    // to be called after changing the geometry of existing primitives in place
+    void MovedPrimitives (void) { moved = true; }
+    Geometry *GetGeometry (const int prim_ndx) { return prims[prim_ndx]->g; }
     bool trace (Ray r, Intersection *isect);
+    // trace() for each ray of p, whose bounds must have been computed
+    // (see RayPacket::ComputeBounds()) ; isect and intersected have p.size entries
+    void tracePacket (RayPacket &p, Intersection *isect, bool *intersected);
     bool visibility (Ray s, const float maxL);
+    // visibility() for each ray k of p, up to maxL[k] ; visible has p.size entries
+    // the bounds of p must have been computed (see RayPacket::ComputeBounds())
+    void visibilityPacket (RayPacket &p, const float *maxL, bool *visible);
     void clear();
     int AddMaterial (BRDF *mat) {
         BRDFs.push_back (mat);
         numBRDFs++;
         return (numBRDFs-1);  // the material (BRDF) index is required to the primitive
     }
-    void AddPrimitive (Primitive *prim) {
+    int AddPrimitive (Primitive *prim) {
         // add primitive to scene
         prims.push_back(prim);
         numPrimitives++;
+        return (numPrimitives-1);  // required to update the primitive in place (see GetGeometry())
     }
     void printSummary(void) {
         std::cout << "#primitives = " << numPrimitives << " ; ";
         std::cout << "#lights = " << numLights << " ; ";
-        std::cout << "#materials = " << numBRDFs << " ;" << std::endl;
+        std::cout << "#materials = " << numBRDFs << " ; ";
+        std::cout << "#BVH nodes = " << bvh.numNodes() << " ; ";
+        std::cout << "#triangle blocks = " << bvh.numBlocks() << " ; ";
+        std::cout << "#light BVH nodes = " << lightBVH.numNodes() << " ;" << std::endl;
     }
 };
 
@@ -9,7 +9,7 @@
 #include "BRDF.hpp"
 #include "AmbientLight.hpp"
 
-RGB AmbientShader::shade(bool intersected, Intersection isect, int depth) {
+RGB AmbientShader::shade(bool intersected, Intersection isect, int depth, Sampler &sampler) {
     RGB color(0.,0.,0.);
     
     /*if (isect.pix_x==320 && isect.pix_y==240) {
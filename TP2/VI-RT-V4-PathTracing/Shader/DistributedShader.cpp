@@ -11,7 +11,7 @@
 
 #include "Shader_Utils.hpp"
 
-RGB DistributedShader::specularReflection (Intersection isect, BRDF *f, int depth) {
+RGB DistributedShader::specularReflection (Intersection isect, BRDF *f, int depth, Sampler &sampler) {
     RGB color(0.,0.,0.);
 
     // generate the specular ray
@@ -34,12 +34,12 @@ RGB DistributedShader::specularReflection (Intersection isect, BRDF *f, int dept
     intersected = scene->trace(specular, &s_isect);
 
     // shade this intersection
-    color = f->Ks * shade (intersected, s_isect, depth+1);
+    color = f->Ks * shade (intersected, s_isect, depth+1, sampler);
 
     return color;
 }
 
-RGB DistributedShader::specularTransmission (Intersection isect, BRDF *f, int depth) {
+RGB DistributedShader::specularTransmission (Intersection isect, BRDF *f, int depth, Sampler &sampler) {
     RGB color(0., 0., 0.);
 
     // generate the transmission ray
@@ -76,13 +76,13 @@ RGB DistributedShader::specularTransmission (Intersection isect, BRDF *f, int de
     intersected = scene->trace(refraction, &t_isect);
 
     // shade this intersection
-    color = f->Kt * shade (intersected, t_isect, depth+1);
+    color = f->Kt * shade (intersected, t_isect, depth+1, sampler);
    
     return color;
 }
 
 
-RGB DistributedShader::shade(bool intersected, Intersection isect, int depth) {
+RGB DistributedShader::shade(bool intersected, Intersection isect, int depth, Sampler &sampler) {
     RGB color(0.,0.,0.);
     
     // if no intersection, return background
@@ -98,15 +98,16 @@ RGB DistributedShader::shade(bool intersected, Intersection isect, int depth) {
     #define MAX_DEPTH 3
     // if there is a specular component sample it
     if (!f->Ks.isZero() && depth<MAX_DEPTH) {
-        color += specularReflection (isect, f, depth+1);
+        color += specularReflection (isect, f, depth+1, sampler);
     }
     // if there is a specular component sample it
     if (!f->Kt.isZero() && depth<MAX_DEPTH) {
-        color += specularTransmission (isect, f, depth+1);
+        color += specularTransmission (isect, f, depth+1, sampler);
     }
     
-    color += directLighting(scene, isect, f, rng, U_dist, UNIFORM_ONE);
-    //color += directLighting(scene, isect, f, rng, U_dist, ALL_LIGHTS);
+    color += directLighting(scene, isect, f, sampler, LIGHT_BVH_ONE);
+    //color += directLighting(scene, isect, f, sampler, UNIFORM_ONE);
+    //color += directLighting(scene, isect, f, sampler, ALL_LIGHTS);
 
     return color;
 };
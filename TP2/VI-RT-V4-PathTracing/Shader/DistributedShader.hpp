@@ -11,23 +11,16 @@
 #include "shader.hpp"
 #include "BRDF.hpp"
 #include "directLighting.hpp"
-#include <random>
 
 class DistributedShader: public Shader {
     RGB background;
-    RGB specularReflection (Intersection isect, BRDF *f, int depth);
-    RGB specularTransmission (Intersection isect, BRDF *f, int depth);
-    /****************************************
-     
-     Our Random Number Generator (rng) */
-    std::random_device rdev{};
-    std::mt19937 rng{rdev()};
-    std::uniform_real_distribution<float>U_dist{0.0,1.0};  // uniform distribution in[0,1[
+    RGB specularReflection (Intersection isect, BRDF *f, int depth, Sampler &sampler);
+    RGB specularTransmission (Intersection isect, BRDF *f, int depth, Sampler &sampler);
 
 
 public:
     DistributedShader (Scene *scene, RGB bg): background(bg), Shader(scene) {}
-    RGB shade (bool intersected, Intersection isect, int depth);
+    RGB shade (bool intersected, Intersection isect, int depth, Sampler &sampler);
 };
 
 #endif /* AmbientShader_hpp */
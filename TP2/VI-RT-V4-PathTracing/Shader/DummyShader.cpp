@@ -7,7 +7,7 @@
 
 #include "DummyShader.hpp"
 
-RGB DummyShader::shade(bool intersected, Intersection isect, int depth) {
+RGB DummyShader::shade(bool intersected, Intersection isect, int depth, Sampler &sampler) {
     /*if (isect.pix_x==320 && isect.pix_y==240) {
         fprintf (stderr, "DUMMY SHADER. intersected = %s !\n", (intersected?"TRUE":"FALSE"));
         fflush(stderr);
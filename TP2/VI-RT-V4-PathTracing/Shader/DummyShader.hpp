@@ -17,7 +17,7 @@ public:
         W = (float)_W;
         H = (float)_H;
     }
-    RGB shade (bool intersected, Intersection isect, int depth);
+    RGB shade (bool intersected, Intersection isect, int depth, Sampler &sampler);
 };
 
 #endif /* DummyShader_hpp */
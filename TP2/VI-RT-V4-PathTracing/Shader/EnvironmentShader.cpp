@@ -11,7 +11,7 @@
 
 #include "Shader_Utils.hpp"
 
-RGB EnvironmentShader::specularReflection (Intersection isect, BRDF *f, int depth) {
+RGB EnvironmentShader::specularReflection (Intersection isect, BRDF *f, int depth, Sampler &sampler) {
     RGB color(0.,0.,0.);
 
     // generate the specular ray
@@ -34,12 +34,12 @@ RGB EnvironmentShader::specularReflection (Intersection isect, BRDF *f, int dept
     intersected = scene->trace(specular, &s_isect);
 
     // shade this intersection
-    color = f->Ks * shade (intersected, s_isect, depth+1, specular.dir);
+    color = f->Ks * shade (intersected, s_isect, depth+1, sampler, specular.dir);
 
     return color;
 }
 
-RGB EnvironmentShader::specularTransmission (Intersection isect, BRDF *f, int depth) {
+RGB EnvironmentShader::specularTransmission (Intersection isect, BRDF *f, int depth, Sampler &sampler) {
     RGB color(0., 0., 0.);
 
     // generate the transmission ray
@@ -76,17 +76,17 @@ RGB EnvironmentShader::specularTransmission (Intersection isect, BRDF *f, int de
     intersected = scene->trace(refraction, &t_isect);
 
     // shade this intersection
-    color = f->Kt * shade (intersected, t_isect, depth+1, refraction.dir);
+    color = f->Kt * shade (intersected, t_isect, depth+1, sampler, refraction.dir);
    
     return color;
 }
 
-RGB EnvironmentShader::shade(bool intersected, Intersection isect, int depth) {
-    return shade(intersected, isect, depth, -isect.wo); // ou outra direção
+RGB EnvironmentShader::shade(bool intersected, Intersection isect, int depth, Sampler &sampler) {
+    return shade(intersected, isect, depth, sampler, -isect.wo); // ou outra direção
 }
 
 
-RGB EnvironmentShader::shade(bool intersected, Intersection isect, int depth, const Vector& ray_dir) {
+RGB EnvironmentShader::shade(bool intersected, Intersection isect, int depth, Sampler &sampler, const Vector& ray_dir) {
     RGB color(0.,0.,0.);
     
     // if no intersection, return background
@@ -110,7 +110,7 @@ RGB EnvironmentShader::shade(bool intersected, Intersection isect, int depth, co
     // if there is a specular component sample it
     if (!f->Ks.isZero()) {
         if (depth < MAX_DEPTH) {
-            color += specularReflection(isect, f, depth + 1);
+            color += specularReflection(isect, f, depth + 1, sampler);
         } else {
             // Fallback: usar IBL diretamente, sem ray tracing
             Vector v = -isect.wo;  // direção da câmara
@@ -131,11 +131,11 @@ RGB EnvironmentShader::shade(bool intersected, Intersection isect, int depth, co
 
     // if there is a specular component sample it
     if (!f->Kt.isZero() && depth<MAX_DEPTH) {
-        color += specularTransmission (isect, f, depth+1);
+        color += specularTransmission (isect, f, depth+1, sampler);
     }
     
-    //color += directLighting(scene, isect, f, rng, U_dist, UNIFORM_ONE);
-    color += directLighting(scene, isect, f, rng, U_dist, ALL_LIGHTS);
+    //color += directLighting(scene, isect, f, sampler, UNIFORM_ONE);
+    color += directLighting(scene, isect, f, sampler, ALL_LIGHTS);
 
     return color;
 };
@@ -10,41 +10,44 @@
 #include "ray.hpp"
 
 #include "Shader_Utils.hpp"
+#include "AreaLight.hpp"
+#include "EnvironmentLight.hpp"
 
-RGB PathTracing::specularReflection (Intersection isect, BRDF *f, int depth) {
-    RGB color(0.,0.,0.);
+// light selection used by directLightingSample() (a single light per vertex)
+// must be the same for the light samples and the weights of the BRDF samples (MIS)
+#define DIRECT_MODE LIGHT_BVH_ONE
+//#define DIRECT_MODE UNIFORM_ONE
 
+static RGB GetKd (const Intersection &isect) {
+    BRDF *f = isect.f;
+    if (f->textured) {
+        DiffuseTexture * df = (DiffuseTexture *)f;
+        return df->GetKd(isect.TexCoord, isect.TexFootprint);
+    }
+    return f->Kd;
+}
+
+// the ray generators below only set up the next ray of the path ;
+// it is traced (and its throughput updated) by shade()
+
+void PathTracing::specularReflection (const Intersection &isect, Ray *ray) {
     // generate the specular ray
     // direction R = 2 (N.V) N - V
-    Vector Rdir = reflect(isect.wo, isect.sn);
-    Ray specular(isect.p, Rdir, SPEC_REFL);
-    
-    specular.pix_x = isect.pix_x;
-    specular.pix_y = isect.pix_y;
-    
-    specular.FaceID = isect.FaceID;
-
-    specular.adjustOrigin(isect.gn);
-    specular.propagating_eta = isect.incident_eta;  // same medium
-
-    // OK, we have the ray : trace and shade it recursively
-    bool intersected;
-    Intersection s_isect;
-    // trace ray
-    intersected = scene->trace(specular, &s_isect);
-
-    // shade this intersection
-    color = f->Ks * shade (intersected, s_isect, depth+1);
+    ray->dir = reflect(isect.wo, isect.sn);
+    ray->o = isect.p;
+    ray->rtype = SPEC_REFL;
+    ray->invertDir();
 
-    return color;
-}
+    ray->FaceID = isect.FaceID;
 
-RGB PathTracing::specularTransmission (Intersection isect, BRDF *f, int depth) {
-    RGB color(0., 0., 0.);
+    ray->adjustOrigin(isect.gn);
+    ray->propagating_eta = isect.incident_eta;  // same medium
+}
 
+void PathTracing::specularTransmission (const Intersection &isect, Ray *ray) {
     // generate the transmission ray
     // from https://raytracing.github.io/books/RayTracingInOneWeekend.html#dielectrics
-    
+
     // direction T = IOR * V
     // IOR of the new media
     float new_eta;
@@ -60,163 +63,189 @@ RGB PathTracing::specularTransmission (Intersection isect, BRDF *f, int depth) {
         new_eta = 1.0f;
     }
 
-    
+
     float const IOR = isect.incident_eta / new_eta;
     Vector const V = -1.*isect.wo;
     Vector const N = isect.sn;
-    
+
     auto cos_theta = std::fmin(N.dot(-1.*V), 1.0);
     double sin_theta = std::sqrt(1.0 - cos_theta*cos_theta);
-    
+
     // is there total internal reflection ?
     bool const cannot_refract = (IOR*sin_theta>1.);
-    
-    Vector const dir = (cannot_refract ? reflect(V,N) : refract (V, N, IOR));
-
-    Ray refraction(isect.p, dir, (cannot_refract ? SPEC_REFL : SPEC_TRANS));
-    
-    refraction.pix_x = isect.pix_x;
-    refraction.pix_y = isect.pix_y;
-    
-    refraction.FaceID = isect.FaceID;
-
-    refraction.adjustOrigin(-1. * isect.gn);
-    
-    refraction.propagating_eta = (cannot_refract ? isect.incident_eta : new_eta);
-
-    // OK, we have the ray : trace and shade it recursively
-    bool intersected;
-    Intersection t_isect;
-    // trace ray
-    intersected = scene->trace(refraction, &t_isect);
-
-    // shade this intersection
-    color = f->Kt * shade (intersected, t_isect, depth+1);
-   
-    return color;
+
+    ray->dir = (cannot_refract ? reflect(V,N) : refract (V, N, IOR));
+    ray->o = isect.p;
+    ray->rtype = (cannot_refract ? SPEC_REFL : SPEC_TRANS);
+    ray->invertDir();
+
+    ray->FaceID = isect.FaceID;
+
+    ray->adjustOrigin(-1. * isect.gn);
+
+    ray->propagating_eta = (cannot_refract ? isect.incident_eta : new_eta);
 }
 
-RGB PathTracing::diffuseReflection (Intersection isect, BRDF *f, int depth) {
-    RGB color(0.,0.,0.);
-    Vector dir;
+float PathTracing::diffuseReflection (const Intersection &isect, Sampler &sampler, Ray *ray) {
     float pdf;
-    
-    // generate the specular ray
-    
+
     // actual direction distributed around N
     // get 2 random number in [0,1[
     float rnd[2];
-    rnd[0] = U_dist(rng);
-    rnd[1] = U_dist(rng);
-        
+    rnd[0] = sampler.Get1D();
+    rnd[1] = sampler.Get1D();
+
     Vector D_around_Z;
-    
+
     // Sample the HemiSphere
     // Uniform
     //pdf = UniformHemiSphereSample (rnd, D_around_Z);
     // Cosine Sampled
     pdf = CosineHemiSphereSample (rnd, D_around_Z);
 
-    // independently of the sampling function
-    // the cosine of theta is always equal do D_around_Z.Z
-    
-    float const cos_theta = D_around_Z.Z;
     // generate a coordinate system from N
     Vector Rx, Ry;
     isect.gn.CoordinateSystem(&Rx, &Ry);
 
     // rotate sampling direction to world space
-    dir = D_around_Z.Rotate  (Rx, Ry, isect.sn);
-
-    Ray diffuse(isect.p, dir, DIFF_REFL);
-        
-    diffuse.pix_x = isect.pix_x;
-    diffuse.pix_y = isect.pix_y;
-        
-    diffuse.FaceID = isect.FaceID;
-    
-    diffuse.adjustOrigin(isect.sn);
-    diffuse.propagating_eta = isect.incident_eta;  // same medium
-
-    // OK, we have the ray : trace and shade it recursively
-    bool intersected;
-    Intersection d_isect;
-    // trace ray
-    intersected = scene->trace(diffuse, &d_isect);
-
-    if (!d_isect.isLight) {  // if light source return 0 ; handled by direct
-        // shade this intersection
-        RGB Rcolor = shade (intersected, d_isect, depth+1);
-            
-        color = (f->Kd * cos_theta * Rcolor) / pdf ;
-    }
-    return color;
+    ray->dir = D_around_Z.Rotate  (Rx, Ry, isect.sn);
+    ray->o = isect.p;
+    ray->rtype = DIFF_REFL;
+    ray->invertDir();
+
+    ray->FaceID = isect.FaceID;
+
+    ray->adjustOrigin(isect.sn);
+    ray->propagating_eta = isect.incident_eta;  // same medium
 
+    return pdf;
 }
 
-RGB PathTracing::shade(bool intersected, Intersection isect, int depth) {
-    RGB color(0.,0.,0.);
-    
+// the diffuse BRDF is Kd/PI: Kd*cos/pdf becomes Kd (cosine sampling),
+// while directLighting() returns Kd*L*cos (the lights' radiance is thus PI*L)
+
+RGB PathTracing::Emitted (bool intersected, const Intersection &isect, const Vector &dir, float bsdfPdf, const Point &prevP, const Vector &prevN) {
     // if no intersection, return background
     if (!intersected) {
-        return (background);
+        if (bsdfPdf > 0.f && scene->environmentLight >= 0) {
+            EnvironmentLight *env = (EnvironmentLight *)scene->lights[scene->environmentLight];
+            const float lightPdf = directLightingPdf(scene, prevP, prevN, scene->environmentLight, dir, INFINITY, DIRECT_MODE);
+            return env->L(dir) * ((float)M_PI * PowerHeuristic(bsdfPdf, lightPdf));
+        }
+        return background;
     }
-    if (isect.isLight) { // intersection with a light source
-        return isect.Le;
+    // intersection with a light source
+    if (bsdfPdf <= 0.f) return isect.Le;
+    // emission reached by a diffuse ray is weighted against the
+    // light samples of directLighting() with the power heuristic (MIS)
+    // pbrt 3rd edition, sec 14.3.1
+    // one sided emitters: nothing is emitted backwards
+    // the radiance is the one used by the light samples (AreaLight::Sample_L())
+    Light *l = scene->lights[isect.lightNdx];
+    if (l->type == AREA_LIGHT && dir.dot(((AreaLight *)l)->gem->normal) < 0.f) {
+        const float lightPdf = directLightingPdf(scene, prevP, prevN, isect.lightNdx, dir, isect.depth, DIRECT_MODE);
+        return ((AreaLight *)l)->intensity * ((float)M_PI * PowerHeuristic(bsdfPdf, lightPdf));
     }
-    // get the BRDF
+    return RGB(0., 0., 0.);
+}
+
+bool PathTracing::SampleDirect (const Intersection &isect, const int depth, Sampler &sampler, LightSample *ls) {
+    if (GetKd(isect).isZero()) return false;
+    // the light samples are combined with the diffuse rays (MIS)
+    // whenever the path may continue from this intersection
+    const bool mis = (depth < maxDepth);
+    return directLightingSample(scene, isect, isect.f, sampler, DIRECT_MODE, mis, ls);
+}
+
+bool PathTracing::Continue (const Intersection &isect, const int depth, Sampler &sampler, Ray *ray, float *bsdfPdf) {
+    if (depth >= maxDepth) return false;
+
+    // select one BRDF component proportionally to its reflectance
     BRDF *f = isect.f;
-    
-    // Russian Roullette
-    #define MIN_DEPTH 1
-    #define P_CONTINUE 0.2f
-    float cont=U_dist(rng);
-    if (depth<MIN_DEPTH || cont < P_CONTINUE) {
-
-        float pdf[3], sum, cdf[3];
-        
-        pdf[0] = f->Ks.Y();
-        pdf[1] = f->Kt.Y();
-        pdf[2] = f->Kd.Y();
-        
-        sum = pdf[0] + pdf[1] + pdf[2];
-        pdf[0] /= sum;
-        pdf[1] /= sum;
-        pdf[2] /= sum;
-
-        cdf[0] = pdf[0];
-        cdf[1] = cdf[0] + pdf[1];
-        cdf[2] = cdf[1] + pdf[2];
-        
-        float const rnd = U_dist(rng);
-        
-            // if there is a specular component sample it
-        if (!f->Ks.isZero() && rnd < cdf[0]) {
-            RGB c_aux;
-            c_aux = specularReflection (isect, f, depth);
-            c_aux /= pdf[0];
-            color += c_aux;
-        }
-            // if there is a specular component sample it
-        else if (!f->Kt.isZero() &&  rnd < cdf[1]) {
-            RGB c_aux;
-            c_aux = specularTransmission (isect, f, depth);
-            c_aux /= pdf[1];
-            color += c_aux;
+    float pdf[3], sum, cdf[3];
+
+    pdf[0] = f->Ks.Y();
+    pdf[1] = f->Kt.Y();
+    pdf[2] = f->Kd.Y();
+
+    sum = pdf[0] + pdf[1] + pdf[2];
+    if (sum <= 0.f) return false;
+    pdf[0] /= sum;
+    pdf[1] /= sum;
+    pdf[2] /= sum;
+
+    cdf[0] = pdf[0];
+    cdf[1] = cdf[0] + pdf[1];
+    cdf[2] = cdf[1] + pdf[2];
+
+    float const rnd = sampler.Get1D();
+
+    // if there is a specular component sample it
+    if (!f->Ks.isZero() && rnd < cdf[0]) {
+        specularReflection (isect, ray);
+        ray->throughput = ray->throughput * f->Ks / pdf[0];
+        *bsdfPdf = 0.f;
+    }
+    // if there is a specular transmission component sample it
+    else if (!f->Kt.isZero() &&  rnd < cdf[1]) {
+        specularTransmission (isect, ray);
+        ray->throughput = ray->throughput * f->Kt / pdf[1];
+        *bsdfPdf = 0.f;
+    }
+    // if there is a diffuse component sample it
+    else {
+        const RGB Kd = GetKd(isect);
+        if (Kd.isZero()) return false;
+        *bsdfPdf = diffuseReflection (isect, sampler, ray);
+        ray->throughput = ray->throughput * Kd / pdf[2];
+    }
+
+    // Russian Roulette: after minDepth bounces paths are terminated
+    // with a probability that grows as their throughput decreases
+    // pbrt 3rd edition, sec 14.5.4
+    if (depth >= minDepth) {
+        const float q = std::max(0.05f, 1.f - ray->throughput.Y());
+        if (sampler.Get1D() < q) return false;
+        ray->throughput /= (1.f - q);
+    }
+    return true;
+}
+
+// iterative path tracer: the throughput (ray.throughput) of the path is
+// carried from vertex to vertex ; at each vertex the direct lighting is
+// added and one BRDF component is sampled to continue the path
+// pbrt 3rd edition, sec 14.5.4
+RGB PathTracing::shade(bool intersected, Intersection isect, int depth, Sampler &sampler) {
+    RGB color(0.,0.,0.);
+    Ray ray;
+    ray.throughput = RGB(1., 1., 1.);
+    ray.pix_x = isect.pix_x;
+    ray.pix_y = isect.pix_y;
+
+    // pdf of the last diffuse bounce, 0 if none (MIS weights of the emission it reaches)
+    float bsdfPdf = 0.f;
+    Point prevP;
+    Vector prevN;
+
+    for ( ; ; depth++) {
+        if (!intersected || isect.isLight) {
+            color += ray.throughput * Emitted(intersected, isect, ray.dir, bsdfPdf, prevP, prevN);
+            break;
         }
-            // if there is a diffuse component sample it
-            // do one bounce (do not recurse on indirect diffuse)
-        else if (!f->Kd.isZero() && isect.r_type != DIFF_REFL) {
-            RGB c_aux;
-            c_aux = diffuseReflection (isect, f, depth);
-            c_aux /= pdf[2];
-            color += c_aux;
+
+        LightSample ls;
+        if (SampleDirect(isect, depth, sampler, &ls)) {
+            if (!ls.shadowRay || scene->visibility(ls.shadow, ls.maxL)) {
+                color += ray.throughput * ls.L;
+            }
         }
-        if (depth>=MIN_DEPTH) color /= P_CONTINUE;
-    }
-    if (!f->Kd.isZero()) {
-        color += directLighting(scene, isect, f, rng, U_dist, UNIFORM_ONE);
-        //color += directLighting(scene, isect, f, rng, U_dist, ALL_LIGHTS);
+
+        if (!Continue(isect, depth, sampler, &ray, &bsdfPdf)) break;
+        prevP = isect.p;
+        prevN = isect.sn;
+
+        // trace the next ray of the path
+        intersected = scene->trace(ray, &isect);
     }
     return color;
 };
@@ -11,24 +11,34 @@
 #include "shader.hpp"
 #include "BRDF.hpp"
 #include "directLighting.hpp"
-#include <random>
 
 class PathTracing: public Shader {
     RGB background;
-    RGB diffuseReflection (Intersection isect, BRDF *f, int depth);
-    RGB specularReflection (Intersection isect, BRDF *f, int depth);
-    RGB specularTransmission (Intersection isect, BRDF *f, int depth);
-    /****************************************
-     
-     Our Random Number Generator (rng) */
-    std::random_device rdev{};
-    std::mt19937 rng{rdev()};
-    std::uniform_real_distribution<float>U_dist{0.0,1.0};  // uniform distribution in[0,1[
+    int maxDepth;   // maximum number of bounces
+    int minDepth;   // bounces before Russian roulette may terminate the path
+    // set up the next ray of the path at isect ; diffuseReflection() returns its pdf
+    float diffuseReflection (const Intersection &isect, Sampler &sampler, Ray *ray);
+    void specularReflection (const Intersection &isect, Ray *ray);
+    void specularTransmission (const Intersection &isect, Ray *ray);
 
 
 public:
-    PathTracing (Scene *scene, RGB bg): background(bg), Shader(scene) {}
-    RGB shade (bool intersected, Intersection isect, int depth);
+    PathTracing (Scene *scene, RGB bg, int _maxDepth=5, int _minDepth=1): Shader(scene), background(bg), maxDepth(_maxDepth), minDepth(_minDepth) {}
+    RGB shade (bool intersected, Intersection isect, int depth, Sampler &sampler);
+
+    // the steps of shade() at each vertex of a path (also used by WavefrontRenderer)
+    // bsdfPdf is the pdf of the last diffuse bounce, 0 if the last bounce was specular
+    // (or the camera) ; prevP, prevN are the point and normal where that bounce occurred
+
+    // radiance arriving along dir when the path misses the scene or reaches a light
+    // source (background, environment or emission), to be multiplied by the throughput
+    RGB Emitted (bool intersected, const Intersection &isect, const Vector &dir, float bsdfPdf, const Point &prevP, const Vector &prevN);
+    // one light sample at isect (see directLightingSample())
+    bool SampleDirect (const Intersection &isect, const int depth, Sampler &sampler, LightSample *ls);
+    // samples one BRDF component at isect, the depth-th vertex, to continue the path:
+    // sets up *ray, multiplies ray->throughput and applies Russian roulette
+    // returns false if the path terminates
+    bool Continue (const Intersection &isect, const int depth, Sampler &sampler, Ray *ray, float *bsdfPdf);
 };
 
 #endif /* PathTracing_hpp */
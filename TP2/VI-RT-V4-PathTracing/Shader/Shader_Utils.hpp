@@ -43,4 +43,12 @@ static float CosineHemiSphereSample (float *rnd, Vector &D) {
     return pdf;
 }
 
+// weight of a sample drawn with density fPdf when combined (MIS) with
+// a strategy of density gPdf, one sample each
+// pbrt 3rd edition, sec 13.10.1
+inline float PowerHeuristic (const float fPdf, const float gPdf) {
+    const float f = fPdf * fPdf, g = gPdf * gPdf;
+    return (f + g > 0.f ? f / (f + g) : 0.f);
+}
+
 #endif // _ShaderUtils_hpp_
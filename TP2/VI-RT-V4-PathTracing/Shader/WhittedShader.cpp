@@ -68,7 +68,7 @@ static RGB directLighting (Scene *scene, Intersection isect, BRDF *f) {
     return color;
 }
 
-RGB WhittedShader::specularReflection (Intersection isect, BRDF *f, int depth) {
+RGB WhittedShader::specularReflection (Intersection isect, BRDF *f, int depth, Sampler &sampler) {
     RGB color(0.,0.,0.);
     
     // generate the specular ray
@@ -92,12 +92,12 @@ RGB WhittedShader::specularReflection (Intersection isect, BRDF *f, int depth) {
     intersected = scene->trace(specular, &s_isect);
 
     // shade this intersection
-    color = f->Ks * shade (intersected, s_isect, depth+1);
+    color = f->Ks * shade (intersected, s_isect, depth+1, sampler);
 
     return color;
 }
 
-RGB WhittedShader::specularTransmission (Intersection isect, BRDF *f, int depth) {
+RGB WhittedShader::specularTransmission (Intersection isect, BRDF *f, int depth, Sampler &sampler) {
     RGB color(0., 0., 0.);
 
     // generate the transmission ray
@@ -134,12 +134,12 @@ RGB WhittedShader::specularTransmission (Intersection isect, BRDF *f, int depth)
     intersected = scene->trace(refraction, &t_isect);
 
     // shade this intersection
-    color = f->Kt * shade (intersected, t_isect, depth+1);
+    color = f->Kt * shade (intersected, t_isect, depth+1, sampler);
    
     return color;
 }
 
-RGB WhittedShader::shade(bool intersected, Intersection isect, int depth) {
+RGB WhittedShader::shade(bool intersected, Intersection isect, int depth, Sampler &sampler) {
     RGB color(0.,0.,0.);
     
     // if no intersection, return background
@@ -156,13 +156,13 @@ RGB WhittedShader::shade(bool intersected, Intersection isect, int depth) {
     // if there is a specular component sample it
     if (!f->Ks.isZero() && depth<MAX_DEPTH) {
         RGB scolor;
-        scolor = specularReflection (isect, f, depth);
+        scolor = specularReflection (isect, f, depth, sampler);
         color += scolor;
     }
     // if there is a specular component sample it
     if (!f->Kt.isZero() && depth<MAX_DEPTH) {
         RGB tcolor;
-        tcolor = specularTransmission (isect, f, depth);
+        tcolor = specularTransmission (isect, f, depth, sampler);
         color += tcolor;
     }
     
@@ -14,11 +14,11 @@
 
 class WhittedShader: public Shader {
     RGB background;
-    RGB specularReflection (Intersection isect, BRDF *f, int depth);
-    RGB specularTransmission (Intersection isect, BRDF *f, int depth);
+    RGB specularReflection (Intersection isect, BRDF *f, int depth, Sampler &sampler);
+    RGB specularTransmission (Intersection isect, BRDF *f, int depth, Sampler &sampler);
 public:
     WhittedShader (Scene *scene, RGB bg): background(bg), Shader(scene) {}
-    RGB shade (bool intersected, Intersection isect, int depth);
+    RGB shade (bool intersected, Intersection isect, int depth, Sampler &sampler);
 };
 
 #endif /* AmbientShader_hpp */
@@ -10,310 +10,238 @@
 #include "PointLight.hpp"
 #include "AreaLight.hpp"
 #include "EnvironmentLight.hpp"
+#include "Shader_Utils.hpp"
+
+// each sample_XXX() computes the contribution of one light sample as if it
+// were not occluded, together with the shadow ray that must be tested ;
+// they return false if the sample can not contribute
+static bool sample_AmbientLight (AmbientLight * l, BRDF  *  f, LightSample *ls);
+static bool sample_PointLight (PointLight  *  l, Intersection &isect, const RGB &Kd, LightSample *ls);
+static bool sample_AreaLight (AreaLight * l, Intersection &isect, const RGB &Kd, float *r, const float mis_pmf, LightSample *ls);
+static bool sample_EnvironmentLight(EnvironmentLight* l, Intersection &isect, const RGB &Kd, float *r, const float mis_pmf, LightSample *ls);
+
+// one sample of light l, with one shadow ray for point, area and environment lights
+// if mis_pmf > 0 the light samples are weighted against cosine sampled BRDF samples
+// (power heuristic), mis_pmf being the probability of having selected l
+static bool sample_Light (Light *l, Intersection &isect, BRDF *f, Sampler &sampler, const float mis_pmf, LightSample *ls) {
+    if (l->type == AMBIENT_LIGHT) {  // is it an ambient light ?
+        return sample_AmbientLight ((AmbientLight *)l, f, ls);
+    }
 
-static RGB direct_AmbientLight (AmbientLight * l, BRDF  *  f);
-static RGB direct_PointLight (PointLight  *  l, Scene *scene, Intersection isect, BRDF  *  f);
-static RGB direct_AreaLight (AreaLight * l, Scene *scene, Intersection isect, BRDF* f, float *r);
-static RGB direct_EnvironmentLight(EnvironmentLight* l, Scene *scene,Intersection isect, BRDF* f, float *r);
+    RGB Kd;
+    if (f->textured) {
+        DiffuseTexture * df = (DiffuseTexture *)f;
+        Kd = df->GetKd(isect.TexCoord, isect.TexFootprint);
+    }
+    else {
+        Kd = f->Kd;
+    }
+    if (Kd.isZero()) return false;
 
-static float *baseP;
-static float **areaP;
+    if (l->type == POINT_LIGHT) {  // is it a point light ?
+        return sample_PointLight ((PointLight *)l, isect, Kd, ls);
+    }
+    if (l->type == AREA_LIGHT) {  // is it a area light ?
+        float r[2];
+        r[0] = sampler.Get1D();
+        r[1] = sampler.Get1D();
+        return sample_AreaLight ((AreaLight *)l, isect, Kd, r, mis_pmf, ls);
+    }
+    if (l->type == ENVIRONMENT_LIGHT) {
+        float r[3] = { sampler.Get1D(), sampler.Get1D(), sampler.Get1D() };
+        return sample_EnvironmentLight((EnvironmentLight*)l, isect, Kd, r, mis_pmf, ls);
+    }
+    return false;
+}
 
-void memoryAllocator(int numLights){
-     baseP = (float*)malloc(sizeof(float) * numLights);
-     areaP = (float**)malloc(sizeof(float*) * numLights); 
-     for(int i = 0; i < numLights; i++){
-        areaP[i] = (float*)malloc(sizeof(float)<<1);
-     }
+static RGB visibleContribution (Scene *scene, const LightSample &ls) {
+    if (ls.shadowRay && !scene->visibility(ls.shadow, ls.maxL)) return RGB(0., 0., 0.);
+    return ls.L;
 }
 
-void memoryDeallocator(int numLights){
-    free(baseP);
-    for(int i = 0; i < numLights; i++){
-        free(areaP[i]);
+bool directLightingSample (Scene *scene, Intersection isect, BRDF *f, Sampler &sampler, DIRECT_SAMPLE_MODE mode, bool mis, LightSample *ls) {
+    // a single light, selected proportionally to its power or to its
+    // estimated contribution to isect.p (see Scene::SetLights())
+    // the estimate is divided by its probability
+    float pmf;
+    int l_ndx;
+    if (mode==UNIFORM_ONE) {
+        l_ndx = scene->lightDistribution.Sample(sampler.Get1D(), &pmf);
     }
-    free(areaP);
+    else {
+        l_ndx = scene->lightBVH.Sample(isect.p, isect.sn, sampler.Get1D(), &pmf);
+    }
+    if (l_ndx < 0 || pmf <= 0.f) return false;
+    if (!sample_Light (scene->lights[l_ndx], isect, f, sampler, (mis ? pmf : 0.f), ls)) return false;
+    ls->L = ls->L / pmf;
+    ls->light = l_ndx;
+    return true;
 }
 
-
-RGB directLighting (Scene *scene, Intersection isect, BRDF *f, std::mt19937& rng, std::uniform_real_distribution<float>U_dist, DIRECT_SAMPLE_MODE mode) {
+RGB directLighting (Scene *scene, Intersection isect, BRDF *f, Sampler &sampler, DIRECT_SAMPLE_MODE mode, bool mis) {
     RGB color (0.,0.,0.);
-    
-#define XX 725
-#define YY 540
-    // Loop over scene's light sources
-    for (Light* l : scene->lights) {
+    LightSample ls;
 
-        if (mode==UNIFORM_ONE) {
-            int l_ndx = U_dist(rng)*scene->numLights;
-            if (isect.pix_x==XX && isect.pix_y==YY) {
-                fprintf (stderr, "numLights=%d, l_ndx=%d, ", scene->numLights, l_ndx);
-            }
-            if (l_ndx >= scene->numLights) l_ndx=scene->numLights-1;
-            if (isect.pix_x==XX && isect.pix_y==YY) {
-                fprintf (stderr, "l_ndx_corrected=%d \n", l_ndx);
-            }
-            l = scene->lights[l_ndx];
+    if (mode!=ALL_LIGHTS) {
+        if (directLightingSample(scene, isect, f, sampler, mode, mis, &ls)) {
+            color = visibleContribution(scene, ls);
         }
-        
-        if (l->type == AMBIENT_LIGHT) {  // is it an ambient light ?
-            color += direct_AmbientLight ((AmbientLight *)l, f);
-            continue;
-        }
-        if (l->type == POINT_LIGHT) {  // is it a point light ?
-            color += direct_PointLight ((PointLight *)l, scene, isect, f);
-            continue;
-        } // is POINT_LIGHT
-        if (l->type == AREA_LIGHT) {  // is it a area light ?
-            float r[2];
-            RGB color_temp(0.,0.,0.);
-            r[0] = U_dist(rng);
-            r[1] = U_dist(rng);
-            color_temp = direct_AreaLight ((AreaLight *)l, scene, isect, f, r);
-            color += color_temp;
-            if (isect.pix_x==XX && isect.pix_y==YY) {
-                fprintf (stderr, "ARea light contributes with (%f,%f,%f) \n", color.R, color.G, color.B);
-            }
-        } // is AREA_LIGHT
-        if (l->type == ENVIRONMENT_LIGHT) {
-            float r[2] = { U_dist(rng), U_dist(rng) };
-            color += direct_EnvironmentLight((EnvironmentLight*)l, scene, isect, f, r);
-            continue;
-        }
-        if (mode==UNIFORM_ONE) {
-            color = color * scene->numLights;
-            break;
-        }
-    }  // loop over all light sources
-
-    if (isect.pix_x==XX && isect.pix_y==YY) {
-        fprintf (stderr, "Direct contributes with (%f,%f,%f) \n", color.R, color.G, color.B);
+        return color;
     }
 
-    return color;
-}
-
-/*
-RGB directLighting (Scene *scene, Intersection isect, BRDF *f, std::mt19937& rng, std::uniform_real_distribution<float>U_dist, DIRECT_SAMPLE_MODE mode) {
-    RGB color (0.,0.,0.);
-    //only works with areaLights
-    if(mode==UNIFORM_ONE){
-       // versão com cálculo aproximado da contribuição da luz
-        int i = 0;
-        float sum = 0;
-        for (Light* l : scene->lights) {
-            AreaLight *al = (AreaLight*)l;
-            areaP[i][0] = U_dist(rng);
-            areaP[i][1] = U_dist(rng);
-            float pdf, Ldistance;
-            RGB L;
-            Point Lpos;
-            std::cout << "Light type: " << l->type << std::endl;
-            L = al->Sample_L(areaP[i], &Lpos, pdf);
-            // the pdf computed above is just 1/Area
-            Vector Ldir=isect.p.vec2point(Lpos);
-#if 0
-            //Com cossenos
-            Ldir.normalize();
-            float cosL = Ldir.dot(isect.sn);
-            float cosLN_l = -1.f * Ldir.dot(al->gem->normal);
-            
-            if (cosL > 0 && cosLN_l >0){
-                Ldistance = Ldir.norm();
-                baseP[i] = ((al->power.R + al->power.G + al->power.B) * cosL * cosLN_l * al->gem->area())/(Ldistance*Ldistance);
-                sum += baseP[i];
-            }else{
-                baseP[i] = 0;
-            }
-#else
-        //sem cossenos 
-       Ldistance = Ldir.norm();
-       baseP[i] = ((al->power.R + al->power.G + al->power.B) * al->gem->area())/(Ldistance*Ldistance);
-       sum += baseP[i];
-       //
-#endif
-       i++;
-        }
-
-        float rand = U_dist(rng);
-        float accP =0;
-        int k = 0;
-        for(; k<i-1; k++){
-            baseP[k] /= sum;
-            accP += baseP[k] < 0 ? 0 : baseP[k];
-            if(rand < accP) break;
-        }
-        color = direct_AreaLight((AreaLight*)scene->lights[k], scene, isect, f, areaP[k]) / baseP[k];
-        /* Modo completamente aleatório (comentar tudo o que está para cima)
-        float rand = U_dist(rng);
-        float accP =0;
-        float increment = 1 / scene->numLights;
-        for (Light* l : scene->lights) {
-            accP += increment;
-            if (rand < increment){
-                AreaLight *al = (AreaLight*)l;
-                float u[2];
-                u[0] = U_dist(rng);
-                u[1] = U_dist(rng);
-                color = direct_AreaLight(al, scene, isect, f, u) * scene->numLights;
-                break;
+    // the samples of a batch of lights are generated before any of
+    // their shadow rays is traced ; the random numbers are drawn in the
+    // same order as if each light were resolved at once
+    const int batchSize = 16;
+    LightSample batch[batchSize];
+    const int nLights = (int)scene->lights.size();
+    for (int l0 = 0; l0 < nLights; l0 += batchSize) {
+        int n = 0;
+        for (int l = l0; l < nLights && l < l0 + batchSize; l++) {
+            if (sample_Light (scene->lights[l], isect, f, sampler, (mis ? 1.f : 0.f), &batch[n])) {
+                batch[n].light = l;
+                n++;
             }
-        }*/
-       /*
-    }else{
-    // Loop over scene's light sources
-    for (Light* l : scene->lights) {
-        //std::cout << "Light type: " << l->type << std::endl;
-        if (l->type == AMBIENT_LIGHT) {  // is it an ambient light ?
-            color += direct_AmbientLight ((AmbientLight *)l, f);
-            continue;
         }
-        if (l->type == POINT_LIGHT) {  // is it a point light ?
-            color += direct_PointLight ((PointLight *)l, scene, isect, f);
-            continue;
-        } // is POINT_LIGHT
-        if (l->type == AREA_LIGHT) {  // is it a area light ?
-            float r[2];
-            RGB color_temp(0.,0.,0.);
-            r[0] = U_dist(rng);
-            r[1] = U_dist(rng);
-            color_temp = direct_AreaLight ((AreaLight *)l, scene, isect, f, r);
-            color += color_temp;
-        } // is AREA_LIGHT
-        if (l->type == ENVIRONMENT_LIGHT) {
-            float r[2] = { U_dist(rng), U_dist(rng) };
-            color += direct_EnvironmentLight((EnvironmentLight*)l, scene, isect, f, r);
-            continue;
+        for (int i = 0; i < n; i++) {
+            color += visibleContribution(scene, batch[i]);
         }
     }  // loop over all light sources
-}
-    return color;
-}*/
 
-static RGB direct_AmbientLight (AmbientLight * l, BRDF * f) {
-    RGB color (0., 0., 0.);
-    if (!f->Ka.isZero()) {
-        RGB Ka = f->Ka;
-        color += Ka * l->L();
-    }
-    return (color);
+    return color;
 }
 
-static RGB direct_PointLight (PointLight* l, Scene *scene, Intersection isect, BRDF * f) {
-    RGB color (0., 0., 0.);
-    RGB Kd;
-    
-    if (f->textured) {
-        DiffuseTexture * df = (DiffuseTexture *)f;
-        Kd = df->GetKd(isect.TexCoord);
-    }
-    else {
-        Kd = f->Kd;
-    }
+static bool sample_AmbientLight (AmbientLight * l, BRDF * f, LightSample *ls) {
+    if (f->Ka.isZero()) return false;
+    RGB Ka = f->Ka;
+    ls->L = Ka * l->L();
+    ls->shadowRay = false;
+    return true;
+}
 
-    if (!Kd.isZero()) {
-        Point Lpos;
-        RGB L = l->Sample_L(NULL, &Lpos);
-        Vector Ldir=isect.p.vec2point(Lpos);
-        float Ldistance = Ldir.norm();
-        Ldir.normalize();
-        float cosL = Ldir.dot(isect.sn);
-        if (cosL>0) {
-            
-            Ray shadow = Ray(isect.p, Ldir, SHADOW);
-            shadow.pix_x = isect.pix_x;
-            shadow.pix_y = isect.pix_y;
-            
-            shadow.adjustOrigin(isect.gn);
-            
-            if (scene->visibility(shadow, Ldistance-EPSILON)) {
-                color += L * Kd * cosL;
-                if (Ldistance>0.f) color /= (Ldistance*Ldistance);
-            }
-        }
-    } // Kd is zero
-    
-    return (color);
+static bool sample_PointLight (PointLight* l, Intersection &isect, const RGB &Kd, LightSample *ls) {
+    Point Lpos;
+    RGB L = l->Sample_L(NULL, &Lpos);
+    Vector Ldir=isect.p.vec2point(Lpos);
+    float Ldistance = Ldir.norm();
+    Ldir.normalize();
+    float cosL = Ldir.dot(isect.sn);
+    if (cosL<=0) return false;
+
+    ls->shadow = Ray(isect.p, Ldir, SHADOW);
+    ls->shadow.pix_x = isect.pix_x;
+    ls->shadow.pix_y = isect.pix_y;
+    ls->shadow.adjustOrigin(isect.gn);
+    ls->maxL = Ldistance-EPSILON;
+    ls->shadowRay = true;
+
+    ls->L = L * Kd * cosL;
+    if (Ldistance>0.f) ls->L /= (Ldistance*Ldistance);
+    return true;
 }
 
-static RGB direct_AreaLight (AreaLight* l, Scene *scene, Intersection isect, BRDF* f, float *r) {
-    RGB color (0., 0., 0.);
-    RGB Kd;
+static bool sample_AreaLight (AreaLight* l, Intersection &isect, const RGB &Kd, float *r, const float mis_pmf, LightSample *ls) {
     float pdf, cosL,  cosLN_l, Ldistance;
     RGB L;
     Point Lpos;
 
-    
-    if (f->textured) {
-        DiffuseTexture * df = (DiffuseTexture *)f;
-        Kd = df->GetKd(isect.TexCoord);
-    }
-    else {
-        Kd = f->Kd;
-    }
-
     pdf = 0.;
-    if (!Kd.isZero()) {
-        
-        L = l->Sample_L(r, &Lpos, pdf);
-        // the pdf computed above is just 1/Area
-        Vector Ldir=isect.p.vec2point(Lpos);
-        Ldistance = Ldir.norm();
-        Ldir.normalize();
-        cosL = Ldir.dot(isect.sn);
-        // Ldir points into the light: * -1 to get the correct sign
-        cosLN_l = -1.f * Ldir.dot(l->gem->normal);
-        // The light source will only contribute if the above cosine is positive
-        if (cosL>1.e-4 && cosLN_l>1.e-4) {
-            
-            Ray shadow = Ray(isect.p, Ldir, SHADOW);
-            shadow.pix_x = isect.pix_x;
-            shadow.pix_y = isect.pix_y;
-            
-            shadow.adjustOrigin(isect.gn);
-            
-            if (scene->visibility(shadow, Ldistance-EPSILON)) {
-                color = L * Kd * cosL;
-                if (pdf >0.) color /= pdf;
-                if (Ldistance>0.f) color /= (Ldistance*Ldistance);
-                color *= cosLN_l;
-            }
-        }
-    } // Kd is zero
-        
-    return (color);
+    L = l->Sample_L(r, &Lpos, pdf);
+    // the pdf computed above is just 1/Area
+    Vector Ldir=isect.p.vec2point(Lpos);
+    Ldistance = Ldir.norm();
+    Ldir.normalize();
+    cosL = Ldir.dot(isect.sn);
+    // Ldir points into the light: * -1 to get the correct sign
+    cosLN_l = -1.f * Ldir.dot(l->gem->normal);
+    // The light source will only contribute if the above cosine is positive
+    if (cosL<=1.e-4 || cosLN_l<=1.e-4) return false;
+
+    ls->shadow = Ray(isect.p, Ldir, SHADOW);
+    ls->shadow.pix_x = isect.pix_x;
+    ls->shadow.pix_y = isect.pix_y;
+    ls->shadow.adjustOrigin(isect.gn);
+    ls->maxL = Ldistance-EPSILON;
+    ls->shadowRay = true;
+
+    RGB color = L * Kd * cosL;
+    if (pdf >0.) color /= pdf;
+    if (Ldistance>0.f) color /= (Ldistance*Ldistance);
+    color *= cosLN_l;
+    if (mis_pmf > 0.f) {
+        // both densities per unit solid angle
+        const float lightPdf = mis_pmf * pdf * Ldistance * Ldistance / cosLN_l;
+        color *= PowerHeuristic(lightPdf, cosL / (float)M_PI);
+    }
+    ls->L = color;
+    return true;
 }
 
 
-static RGB direct_EnvironmentLight(EnvironmentLight* l, Scene *scene, Intersection isect, BRDF* f, float *r) {
-    RGB color(0., 0., 0.);
-    RGB Kd;
-
-    if (f->textured) {
-        DiffuseTexture* df = (DiffuseTexture*)f;
-        Kd = df->GetKd(isect.TexCoord);
+static bool sample_EnvironmentLight(EnvironmentLight* l, Intersection &isect, const RGB &Kd, float *r, const float mis_pmf, LightSample *ls) {
+    // without MIS: one sample from the mixture of the probe's luminance
+    // distribution and cosine sampling of the hemisphere around the normal,
+    // r[2] picks the strategy ; the latter bounds the variance where most of
+    // the probe's energy is below the horizon (or occluded)
+    // i.e., one-sample MIS with the balance heuristic, pbrt 3rd edition, sec 13.10.1
+    // with MIS the shader's own BRDF samples play the role of the latter
+    Vector Ldir;
+    float pdf;
+    RGB L;
+    if (mis_pmf > 0.f) {
+        L = l->Sample_L(r, &Ldir, pdf);
+        if (pdf <= 0.f || L.isZero()) return false;
+    }
+    else if (r[2] < 0.5f) {
+        L = l->Sample_L(r, &Ldir, pdf);
+        if (pdf <= 0.f) return false;
     } else {
-        Kd = f->Kd;
+        Vector D_around_Z, Rx, Ry;
+        CosineHemiSphereSample(r, D_around_Z);
+        isect.sn.CoordinateSystem(&Rx, &Ry);
+        Ldir = D_around_Z.Rotate(Rx, Ry, isect.sn);
+        L = l->L(Ldir);
     }
+    float weight = 1.f;
+    const float cosL = Ldir.dot(isect.sn);
+    if (mis_pmf > 0.f) {
+        weight = PowerHeuristic(mis_pmf * pdf, (cosL > 0.f ? cosL / (float)M_PI : 0.f));
+    }
+    else {
+        if (L.isZero()) return false;
+        pdf = 0.5f * l->pdf(Ldir) + 0.5f * (cosL > 0.f ? cosL / (float)M_PI : 0.f);
+        if (pdf <= 0.f) return false;
+    }
+    if (cosL <= 1e-4f) return false;
+
+    ls->shadow = Ray(isect.p, Ldir, SHADOW);
+    ls->shadow.pix_x = isect.pix_x;
+    ls->shadow.pix_y = isect.pix_y;
+    ls->shadow.adjustOrigin(isect.gn);
+    ls->maxL = INFINITY;
+    ls->shadowRay = true;
+
+    ls->L = L * Kd * cosL * weight;
+    ls->L /= pdf;
+    return true;
+}
 
-    if (!Kd.isZero()) {
-        Vector Ldir;
-        float pdf;
-        RGB L = l->Sample_L(r, &Ldir, pdf);
-
-        Ray shadow(isect.p, Ldir, SHADOW);
-        shadow.pix_x = isect.pix_x;
-        shadow.pix_y = isect.pix_y;
-        shadow.adjustOrigin(isect.gn);
-
-        if (scene->visibility(shadow, INFINITY)) {
-            float cosL = Ldir.dot(isect.sn);
-            if (cosL > 1e-4f) {
-                color = L * Kd * cosL;
-                color /= pdf;
-            }
-        }
+float directLightingPdf (Scene *scene, const Point &p, const Vector &n, const int l_ndx, const Vector &wi, const float dist, DIRECT_SAMPLE_MODE mode) {
+    Light *l = scene->lights[l_ndx];
+    float pdf;
+    if (l->type == AREA_LIGHT) {
+        AreaLight *al = (AreaLight *)l;
+        // one sided emitter: wi points into the light
+        const float cosLN_l = -1.f * wi.dot(al->gem->normal);
+        if (cosLN_l <= 1.e-4f) return 0.f;
+        pdf = al->pdf * dist * dist / cosLN_l;
     }
+    else if (l->type == ENVIRONMENT_LIGHT) {
+        pdf = ((EnvironmentLight *)l)->pdf(wi);
+    }
+    else return 0.f;    // point and ambient lights can not be hit
 
-    return color;
+    if (mode==UNIFORM_ONE) pdf *= scene->lightDistribution.PMF(l_ndx);
+    else if (mode==LIGHT_BVH_ONE) pdf *= scene->lightBVH.PMF(p, n, l_ndx);
+    return pdf;
 }
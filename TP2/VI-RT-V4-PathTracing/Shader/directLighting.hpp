@@ -11,16 +11,35 @@
 #include "RGB.hpp"
 #include "intersection.hpp"
 #include "scene.hpp"
-#include <random>
 #include "shader.hpp"
 #include "DiffuseTexture.hpp"
 
 typedef  enum {
         ALL_LIGHTS,
-        UNIFORM_ONE
+        UNIFORM_ONE,    // one light, selected proportionally to its power
+    LIGHT_BVH_ONE   // one light, selected according to its estimated contribution (see LightBVH)
 }    DIRECT_SAMPLE_MODE;
 
-RGB directLighting (Scene *scene, Intersection isect, BRDF *f, std::mt19937& rng, std::uniform_real_distribution<float>U_dist, DIRECT_SAMPLE_MODE mode=ALL_LIGHTS);
-void memoryAllocator(int numLights);
-void memoryDeallocator(int numLights);
+// one light sample: the contribution it carries if the shadow ray is not occluded
+typedef struct LightSample {
+    RGB L;           // already divided by the pdfs (and MIS weighted)
+    Ray shadow;
+    float maxL;      // occluders are searched up to maxL along shadow
+    bool shadowRay;  // false if no visibility test is required (ambient light)
+    int light;       // index on Scene::lights
+} LightSample;
+
+// if mis is true the light samples are weighted with the power heuristic
+// against cosine sampling of the BRDF: the shader must then add the emission
+// reached by its diffuse rays weighted likewise (see directLightingPdf())
+// with ALL_LIGHTS the samples of (up to) 16 lights are generated first and
+// their shadow rays are traced afterwards, all at once
+RGB directLighting (Scene *scene, Intersection isect, BRDF *f, Sampler &sampler, DIRECT_SAMPLE_MODE mode=ALL_LIGHTS, bool mis=false);
+// as directLighting() for a single light (mode != ALL_LIGHTS), without the visibility
+// test: returns false if there is no contribution, otherwise the caller must trace
+// ls->shadow (if ls->shadowRay) and add ls->L if it is not occluded
+bool directLightingSample (Scene *scene, Intersection isect, BRDF *f, Sampler &sampler, DIRECT_SAMPLE_MODE mode, bool mis, LightSample *ls);
+// solid angle density with which directLighting(mode) samples direction wi
+// from point p (normal n) towards light l_ndx, at distance dist (area lights)
+float directLightingPdf (Scene *scene, const Point &p, const Vector &n, const int l_ndx, const Vector &wi, const float dist, DIRECT_SAMPLE_MODE mode);
 #endif /* directLighting_hpp */
@@ -10,13 +10,14 @@
 
 #include "scene.hpp"
 #include "RGB.hpp"
+#include "Sampler.hpp"
 
 class Shader {
 public:
     Scene *scene;
     Shader (Scene *_scene): scene(_scene) {}
     ~Shader () {}
-    virtual RGB shade (bool intersected, Intersection isect, int depth) {return RGB();}
+    virtual RGB shade (bool intersected, Intersection isect, int depth, Sampler &sampler) {return RGB();}
 };
 
 #endif /* shader_hpp */
@@ -18,7 +18,13 @@
 #include "Perspective.hpp"
 #include "DummyRenderer.hpp"
 #include "StandardRenderer.hpp"
+#include "ProgressiveRenderer.hpp"
+#include "AdaptiveRenderer.hpp"
+#include "WavefrontRenderer.hpp"
+#include "PacketRenderer.hpp"
+#include "FramePipeline.hpp"
 #include "ImagePPM.hpp"
+#include "ImageCache.hpp"
 #include "AmbientShader.hpp"
 #include "WhittedShader.hpp"
 #include "DistributedShader.hpp"
@@ -35,6 +41,7 @@
 #include "Matrix/matrix.hpp"
 #include <chrono>
 #include <omp.h>
+#include <memory>
 #define ENV 1
 #define CORNELL_BOX 0
 
@@ -42,6 +49,33 @@
 //CONTA AS FLAGS ACIMA 
 #define FLAG CORNELL_BOX
 
+// 1: render each frame progressively, until a time budget is exhausted
+//    or the pixels converge (see ProgressiveRenderer)
+#define PROGRESSIVE 0
+// 1: spend an average number of samples per pixel where the error is larger
+//    (see AdaptiveRenderer) ; a heat map of the samples is saved as SampleMap<i>.ppm
+#define ADAPTIVE 0
+// 1: advance all the paths of a frame in lockstep, stage by stage (see WavefrontRenderer)
+//    same image as the standard renderer ; requires the PathTracing shader
+#define WAVEFRONT 0
+// 1: trace the primary rays of 8x8 pixel blocks as packets (see PacketRenderer)
+//    same image as the standard renderer
+#define PACKETS 0
+// number of frames rendered at the same time (see FramePipeline) ; 1 unless
+// a single frame is too small to keep all the cores busy
+#define FRAMES_IN_FLIGHT 1
+// 1: keep the decoded HDR probes next to their files (<file>.rgbf), mapped in
+//    memory by the next runs instead of being decoded again (see ImageCache)
+#define IMAGE_SIDECARS 0
+// 1: record the albedo, normal and depth of the first hits while rendering
+//    (see StandardRenderer::aov) and denoise each frame guided by them when
+//    it is saved (see ATrous) ; requires the standard or packet renderer
+#define DENOISE 0
+
+#if DENOISE && (ADAPTIVE || PROGRESSIVE || (WAVEFRONT && !FLAG))
+#error "DENOISE requires the standard or packet renderer"
+#endif
+
 using namespace std::chrono;
 
 Group og_group = Group();
@@ -50,6 +84,16 @@ std::vector<Model> cornell_box_models;
 std::vector<Model> env_scene_models;
 int numberFrames;
 
+// the state of one frame of the pipeline (see FramePipeline): each slot has
+// its own copy of the models and its own scene, brought to the slot's frame
+typedef struct FrameSlot {
+    Scene scene;
+    std::vector<Model> models;
+    ImagePPM *img;
+    AOVBuffer aov;             // read when img is saved (DENOISE)
+    double cpuTime, elapsed;   // rendering times
+} FrameSlot;
+
 std::vector<int> parseModelList(const char* listAttr) {
     std::vector<int> models;
     std::string listStr(listAttr);
@@ -195,33 +239,12 @@ int parsexml(const char *filename) {
 
 void handle_groups(const Group& group) {
     
+    // each keyframe is evaluated at any frame from its whole transformation
+    // (see Matrix::evaluate())
     for (const auto& transform : group.transforms) {
-        if (transform.type == "translate") {
-            Matrix m = Matrix();
-            float dx = transform.x / transform.totalFrames;
-            float dy = transform.y / transform.totalFrames;
-            float dz = transform.z / transform.totalFrames;
-            m.addTranslation(dx, dy, dz, transform.frame, transform.totalFrames, transform.models_indexes);
-            matrixes.push_back(m);
-        } else if (transform.type == "rotate") {
-            Matrix m = Matrix();
-            float anglePerFrame = transform.angle / transform.totalFrames;
-            m.addRotation(transform.x, transform.y, transform.z, anglePerFrame, transform.frame, transform.totalFrames, transform.models_indexes);
-            matrixes.push_back(m);
-        } else if (transform.type == "scale") {
-            // Proteção contra divisão por zero ou valores negativos
-            //x = (x <= 0.0f) ? 1.0f : x;
-            //y = (y <= 0.0f) ? 1.0f : y;
-            //z = (z <= 0.0f) ? 1.0f : z;
-            Matrix m = Matrix();
-
-            float scaleX = std::pow(transform.x, 1.0f / transform.totalFrames);
-            float scaleY = std::pow(transform.y, 1.0f / transform.totalFrames);
-            float scaleZ = std::pow(transform.z, 1.0f / transform.totalFrames); 
-
-            m.addScale(scaleX, scaleY, scaleZ, transform.frame, transform.totalFrames, transform.models_indexes);
-            matrixes.push_back(m);
-        }
+        Matrix m = Matrix();
+        m.setKeyframe(transform.type, transform.angle, transform.x, transform.y, transform.z, transform.frame, transform.totalFrames, transform.models_indexes);
+        matrixes.push_back(m);
     }
 
     for (const auto& sub_group : group.groups) {
@@ -230,12 +253,12 @@ void handle_groups(const Group& group) {
 
 }
 
-void SceneSetup(int i, float& total, Scene& scene, Perspective* cam, ImagePPM* img, const std::vector<Model>& cornell_box_models, const std::vector<Matrix>& matrixes) {
+// renders frame i of the slot's scene ; the image is saved by the pipeline's save stage
+void RenderFrame(int i, FrameSlot& slot, Perspective* cam) {
+    Scene& scene = slot.scene;
+    ImagePPM* img = slot.img;
     Shader* shd;
     clock_t start, end;
-    double cpu_time_used;
-
-    memoryAllocator(scene.numLights);
 
 #if FLAG
 
@@ -246,10 +269,33 @@ void SceneSetup(int i, float& total, Scene& scene, Perspective* cam, ImagePPM* i
     shd = new PathTracing(&scene, RGB(0., 0., 0.2));
 
 #endif
-    const int spp = 16;
     const bool jitter = true;
 
+#if ADAPTIVE
+    const float avgSpp = 16.f;
+    const int maxSpp = 1024;
+    const float errorThreshold = 0.02f;   // relative standard error per pixel
+    AdaptiveRenderer myRender(cam, &scene, img, shd, avgSpp, maxSpp, errorThreshold);
+#elif PROGRESSIVE
+    const int maxSpp = 1024;
+    const float timeBudget = 2.f;         // seconds per frame
+    const float errorThreshold = 0.02f;   // relative standard error per pixel
+    ProgressiveRenderer myRender(cam, &scene, img, shd, maxSpp, timeBudget, errorThreshold, jitter);
+#elif WAVEFRONT && !FLAG
+    const int spp = 16;
+    WavefrontRenderer myRender(cam, &scene, img, shd, spp, jitter);
+#elif PACKETS
+    const int spp = 16;
+    PacketRenderer myRender(cam, &scene, img, shd, spp, jitter);
+#else
+    const int spp = 16;
     StandardRenderer myRender(cam, &scene, img, shd, spp, jitter);
+#endif
+
+#if DENOISE
+    myRender.aov = &slot.aov;
+    img->post.aov = &slot.aov;
+#endif
 
     auto start_clock = high_resolution_clock::now();
     start = clock();
@@ -257,20 +303,13 @@ void SceneSetup(int i, float& total, Scene& scene, Perspective* cam, ImagePPM* i
     end = clock();
     auto end_clock = high_resolution_clock::now();
 
-    cpu_time_used = ((double)(end - start)) / CLOCKS_PER_SEC;
-    double elapsed_seconds = duration<double>(end_clock - start_clock).count();
+    // clock() is the CPU time of the whole process, other stages included
+    slot.cpuTime = ((double)(end - start)) / CLOCKS_PER_SEC;
+    slot.elapsed = duration<double>(end_clock - start_clock).count();
 
-    total += elapsed_seconds;
-
-    memoryDeallocator(scene.numLights);
-
-    img->Save(("MyImage" + std::to_string(i) + ".ppm").c_str());
-
-    fprintf(stdout, "CPU Rendering time = %.3lf secs\n\n", cpu_time_used);
-    fprintf(stdout, "Rendering time = %.3lf secs\n\n", elapsed_seconds);
-    std::cout << "Image saved as MyImage" << i << std::endl;
-    std::cout << "That's all, folks!" << std::endl;
-    scene.clear();
+#if ADAPTIVE
+    myRender.SaveSampleMap("SampleMap" + std::to_string(i) + ".ppm");
+#endif
 
     delete shd; 
 }
@@ -293,17 +332,30 @@ bool checkXML(const std::vector<Matrix>& matrixes, const std::vector<Model>& mod
         }
     }
 
+    // the keyframes are applied in the order of their start frames (see
+    // matrixesCheck()): those of a model active on the same frames must commute
+    for (size_t i = 0; i < matrixes.size(); i++) {
+        for (size_t j = i + 1; j < matrixes.size(); j++) {
+            if (matrixes[i].overlaps(matrixes[j]) && !matrixes[i].commutes(matrixes[j])) {
+                std::cerr << "Error: the " << matrixes[i].type << " at frame " << matrixes[i].frame
+                          << " and the " << matrixes[j].type << " at frame " << matrixes[j].frame
+                          << " transform the same model on the same frames and do not commute." << std::endl;
+                return false;
+            }
+        }
+    }
+
     return true;
 }
 
 
 int main(int argc, const char * argv[]) {
-    Scene scene;
-    ImagePPM *img;    
     Shader *shd;      
     clock_t start, end;
     double cpu_time_used;
 
+    ImageCache::useSidecars = IMAGE_SIDECARS;
+
     int num_cores = omp_get_num_procs();
     std::cout << "Número de cores disponíveis: " << num_cores << std::endl;
     std::cout << "Threads máximas suportadas: " << omp_get_max_threads() << std::endl;
@@ -320,8 +372,6 @@ int main(int argc, const char * argv[]) {
     const int W= 640;
     const int H= 640;
 
-    img = new ImagePPM(W,H);
-    
     /* Scenes*/
     
     /* Single Sphere */
@@ -390,7 +440,6 @@ int main(int argc, const char * argv[]) {
     //shd = new WhittedShader(&scene, RGB(0.1,0.1,0.8));
     //shd = new DistributedShader(&scene, RGB(0.1,0.1,0.8));
     //shd = new EnvironmentShader(&scene, RGB(0.1,0.1,0.8));
-    //memoryAllocator(scene.numLights);
     //shd = new PathTracing(&scene, RGB(0.,0.,0.2));
     // declare the renderer
     int const spp=40;
@@ -404,15 +453,8 @@ int main(int argc, const char * argv[]) {
         return 1;
     }
 
-    EnvScene(0,scene, env_scene_models, matrixes);
-    SceneSetup(0, total, scene, cam, img, env_scene_models, matrixes);
-
-    for(int i = 1; i < numberFrames; i++){
-        
-        EnvScene(i,scene, env_scene_models, matrixes);
-        SceneSetup(i, total, scene, cam, img, env_scene_models, matrixes);
-
-    }
+    void (*BuildFrame)(int, Scene&, std::vector<Model>&, std::vector<Matrix>&) = EnvScene;
+    const std::vector<Model>& models = env_scene_models;
 
 #else 
 
@@ -470,21 +512,56 @@ int main(int argc, const char * argv[]) {
         return 1;
     }
 
-    CornellBox(0,scene, cornell_box_models, matrixes);
-    SceneSetup(0, total, scene, cam, img, cornell_box_models, matrixes);
+    void (*BuildFrame)(int, Scene&, std::vector<Model>&, std::vector<Matrix>&) = CornellBox;
+    const std::vector<Model>& models = cornell_box_models;
 
-    for(int i = 1; i < numberFrames; i++){
-        
-        CornellBox(i,scene, cornell_box_models, matrixes);
-        SceneSetup(i, total, scene, cam, img, cornell_box_models, matrixes);
+#endif
 
+    // frame i+1 is built and frame i-1 saved while frame i renders
+    FramePipeline pipeline(numberFrames, FRAMES_IN_FLIGHT);
+    const int nSlots = pipeline.numSlots();
+    std::unique_ptr<FrameSlot[]> slots(new FrameSlot[nSlots]);
+    for (int s = 0; s < nSlots; s++) {
+        slots[s].models = models;
+        slots[s].img = new ImagePPM(W,H);
     }
 
-#endif
+    auto build = [&](const int i, const int s) {
+        FrameSlot& slot = slots[s];
+        // the scene persists across frames (see CornellBox() and EnvScene()) ;
+        // the models are evaluated at frame i, whichever frame the slot was at
+        BuildFrame(i, slot.scene, slot.models, matrixes);
+        // built on the first frame ; refitted to the moved models afterwards
+        slot.scene.UpdateAccel();
+    };
+    auto render = [&](const int i, const int s) {
+        RenderFrame(i, slots[s], cam);
+    };
+    auto save = [&](const int i, const int s) {
+        FrameSlot& slot = slots[s];
+        slot.img->Save(("MyImage" + std::to_string(i) + ".ppm").c_str());
+
+        total += slot.elapsed;
+        fprintf(stdout, "CPU Rendering time = %.3lf secs\n\n", slot.cpuTime);
+        fprintf(stdout, "Rendering time = %.3lf secs\n\n", slot.elapsed);
+        std::cout << "Image saved as MyImage" << i << std::endl;
+        std::cout << "That's all, folks!" << std::endl;
+    };
+
+    auto start_clock = high_resolution_clock::now();
+    pipeline.Run(build, render, save);
+    auto end_clock = high_resolution_clock::now();
+
+    for (int s = 0; s < nSlots; s++) {
+        slots[s].scene.clear();
+        delete slots[s].img;
+    }
+    ImageCache::Clear();
 
     float average_run_time = total / numberFrames;
 
     std::cout << "Average run time: " << average_run_time << " seconds" << std::endl;
+    std::cout << "Total time: " << duration<double>(end_clock - start_clock).count() << " seconds" << std::endl;
 
     return 0;
 }
@@ -0,0 +1,92 @@
+//
+//  AliasTable.hpp
+//  VI-RT-V4-PathTracing
+//
+//  discrete distribution sampled in O(1) with Walker's alias method
+//  based on pbrt 4th edition, sec A.1 (pbrt.org)
+//
+
+#ifndef AliasTable_hpp
+#define AliasTable_hpp
+
+#include <vector>
+#include <stddef.h>
+
+class AliasTable {
+    typedef struct Bin {
+        float q;     // probability of keeping this bin (instead of its alias)
+        float p;     // probability of this bin (pmf)
+        int alias;
+    } Bin;
+    std::vector<Bin> bins;
+public:
+    AliasTable () {}
+    // weights must be non negative ; if they are all zero the distribution is uniform
+    AliasTable (const std::vector<float> &weights) { Build(weights); }
+
+    // Vose's algorithm: bins with probability below the average are
+    // paired with (part of) a bin above the average
+    void Build (const std::vector<float> &weights) {
+        const int n = (int)weights.size();
+        bins.assign(n, Bin());
+        if (n==0) return;
+        double sum = 0.;
+        for (int i=0 ; i<n ; i++) sum += weights[i];
+        for (int i=0 ; i<n ; i++) {
+            bins[i].p = (sum > 0. ? (float)(weights[i] / sum) : 1.f / n);
+            bins[i].alias = -1;
+        }
+
+        typedef struct Outcome {
+            float pHat;   // probability scaled by n: 1 is the average
+            int index;
+        } Outcome;
+        std::vector<Outcome> under, over;
+        for (int i=0 ; i<n ; i++) {
+            const Outcome o = {bins[i].p * n, i};
+            if (o.pHat < 1.f) under.push_back(o);
+            else over.push_back(o);
+        }
+        while (!under.empty() && !over.empty()) {
+            const Outcome un = under.back();
+            under.pop_back();
+            Outcome ov = over.back();
+            over.pop_back();
+            bins[un.index].q = un.pHat;
+            bins[un.index].alias = ov.index;
+            // the excess of ov goes back to one of the lists
+            ov.pHat -= 1.f - un.pHat;
+            if (ov.pHat < 1.f) under.push_back(ov);
+            else over.push_back(ov);
+        }
+        // what is left has (up to rounding errors) probability 1/n
+        while (!over.empty()) {
+            bins[over.back().index].q = 1.f;
+            bins[over.back().index].alias = -1;
+            over.pop_back();
+        }
+        while (!under.empty()) {
+            bins[under.back().index].q = 1.f;
+            bins[under.back().index].alias = -1;
+            under.pop_back();
+        }
+    }
+    // u uniform in [0,1[ ; returns the sampled index (-1 if the table is empty)
+    // and, if pmf is not NULL, its probability
+    int Sample (const float u, float *pmf=NULL) const {
+        const int n = (int)bins.size();
+        if (n==0) return -1;
+        const float OneMinusEpsilon = 0.99999994f;
+        int offset = (int)(u * n);
+        if (offset > n-1) offset = n-1;
+        float up = u * n - offset;   // u remapped to [0,1[ within the bin
+        if (up > OneMinusEpsilon) up = OneMinusEpsilon;
+        const int ndx = (up < bins[offset].q ? offset : bins[offset].alias);
+        if (pmf!=NULL) *pmf = bins[ndx].p;
+        return ndx;
+    }
+    float PMF (const int ndx) const { return bins[ndx].p; }
+    int size (void) const { return (int)bins.size(); }
+};
+
+#endif /* AliasTable_hpp */
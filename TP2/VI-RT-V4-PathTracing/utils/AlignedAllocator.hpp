@@ -0,0 +1,37 @@
+//
+//  AlignedAllocator.hpp
+//  VI-RT-V4-PathTracing
+//
+//  allocator for std::vector whose storage is aligned on Alignment bytes,
+//  which the default one only guarantees up to alignof(max_align_t) in C++11
+//
+
+#ifndef AlignedAllocator_hpp
+#define AlignedAllocator_hpp
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <new>
+
+template <class T, size_t Alignment>
+struct AlignedAllocator {
+    typedef T value_type;
+    template <class U> struct rebind { typedef AlignedAllocator<U, Alignment> other; };
+
+    AlignedAllocator () {}
+    template <class U> AlignedAllocator (const AlignedAllocator<U, Alignment> &) {}
+
+    T *allocate (const size_t n) {
+        void *p = NULL;
+        if (posix_memalign(&p, Alignment, n * sizeof(T)) != 0) throw std::bad_alloc();
+        return (T *)p;
+    }
+    void deallocate (T *p, size_t) { free(p); }
+};
+
+template <class T, class U, size_t Alignment>
+bool operator== (const AlignedAllocator<T, Alignment> &, const AlignedAllocator<U, Alignment> &) { return true; }
+template <class T, class U, size_t Alignment>
+bool operator!= (const AlignedAllocator<T, Alignment> &, const AlignedAllocator<U, Alignment> &) { return false; }
+
+#endif /* AlignedAllocator_hpp */
@@ -0,0 +1,95 @@
+//
+//  Distribution.hpp
+//  VI-RT-V4-PathTracing
+//
+//  piecewise constant 1D and 2D distributions sampled by inverting their CDFs
+//  based on pbrt 3rd edition, sec 13.3.1 and 13.6.7 (pbrt.org)
+//
+
+#ifndef Distribution_hpp
+#define Distribution_hpp
+
+#include <vector>
+#include <algorithm>
+
+// piecewise constant function over [0,1[ with n equally sized segments
+class Distribution1D {
+    std::vector<float> func, cdf;
+    float funcInt;
+public:
+    Distribution1D (): funcInt(0.f) {}
+    // f must be non negative ; if it is zero everywhere the distribution is uniform
+    Distribution1D (const float *f, const int n) { Build(f, n); }
+
+    void Build (const float *f, const int n) {
+        func.assign(f, f+n);
+        cdf.assign(n+1, 0.f);
+        if (n==0) { funcInt = 0.f; return; }
+        // running integral of func
+        for (int i=1 ; i<=n ; i++) cdf[i] = cdf[i-1] + func[i-1] / n;
+        funcInt = cdf[n];
+        if (funcInt == 0.f) {
+            for (int i=1 ; i<=n ; i++) cdf[i] = (float)i / n;
+        } else {
+            for (int i=1 ; i<=n ; i++) cdf[i] /= funcInt;
+        }
+    }
+    int Count (void) const { return (int)func.size(); }
+    float Integral (void) const { return funcInt; }
+    // u uniform in [0,1[ ; returns x in [0,1[ with density pdf
+    // and, if offset is not NULL, the segment x falls in
+    float SampleContinuous (const float u, float *pdf, int *offset=NULL) const {
+        const int n = Count();
+        // last cdf entry <= u
+        int o = (int)(std::upper_bound(cdf.begin(), cdf.end(), u) - cdf.begin()) - 1;
+        o = std::max(0, std::min(o, n-1));
+        if (offset!=NULL) *offset = o;
+        float du = u - cdf[o];
+        if (cdf[o+1] - cdf[o] > 0.f) du /= cdf[o+1] - cdf[o];
+        if (pdf!=NULL) *pdf = (funcInt > 0.f ? func[o] / funcInt : 1.f);
+        const float x = (o + du) / n;
+        return (x < 0.99999994f ? x : 0.99999994f);
+    }
+    // density of SampleContinuous() returning a value in segment o
+    float Pdf (const int o) const {
+        return (funcInt > 0.f ? func[o] / funcInt : 1.f);
+    }
+};
+
+// piecewise constant function over [0,1[^2 given as nu x nv values (row major)
+// sampled as the marginal over v followed by the conditional over u
+class Distribution2D {
+    std::vector<Distribution1D> pConditionalV;
+    Distribution1D pMarginal;
+public:
+    Distribution2D () {}
+    Distribution2D (const float *f, const int nu, const int nv) { Build(f, nu, nv); }
+
+    void Build (const float *f, const int nu, const int nv) {
+        pConditionalV.assign(nv, Distribution1D());
+        std::vector<float> marginalFunc(nv);
+        for (int v=0 ; v<nv ; v++) {
+            pConditionalV[v].Build(&f[v*nu], nu);
+            marginalFunc[v] = pConditionalV[v].Integral();
+        }
+        pMarginal.Build(marginalFunc.data(), nv);
+    }
+    bool IsEmpty (void) const { return pConditionalV.empty(); }
+    // u uniform in [0,1[^2 ; returns (u,v) in [0,1[^2 and its density
+    void SampleContinuous (const float u[2], float uv[2], float *pdf) const {
+        float pdfs[2];
+        int v;
+        uv[1] = pMarginal.SampleContinuous(u[1], &pdfs[1], &v);
+        uv[0] = pConditionalV[v].SampleContinuous(u[0], &pdfs[0]);
+        *pdf = pdfs[0] * pdfs[1];
+    }
+    // density of SampleContinuous() returning (u,v)
+    float Pdf (const float u, const float v) const {
+        const int nu = pConditionalV[0].Count(), nv = pMarginal.Count();
+        const int iu = std::max(0, std::min((int)(u * nu), nu-1));
+        const int iv = std::max(0, std::min((int)(v * nv), nv-1));
+        return pConditionalV[iv].Pdf(iu) * pMarginal.Pdf(iv);
+    }
+};
+
+#endif /* Distribution_hpp */
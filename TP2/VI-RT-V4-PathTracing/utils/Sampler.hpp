@@ -0,0 +1,86 @@
+//
+//  Sampler.hpp
+//  VI-RT-V4-PathTracing
+//
+//  uniform random numbers for rendering: a PCG32 generator
+//  whose stream depends only on (seed, pixel, sample index),
+//  hence renders are reproducible independently of the thread
+//  that computes each pixel
+//  based on pbrt 3rd edition, sec 7.1 and A.1 (pbrt.org)
+//  and pbrt 4th edition, sec 8.3 (IndependentSampler)
+//
+
+#ifndef Sampler_hpp
+#define Sampler_hpp
+
+#include <stdint.h>
+
+// PCG32 (https://www.pcg-random.org)
+#define PCG32_DEFAULT_STATE 0x853c49e6748fea9bULL
+#define PCG32_MULT 0x5851f42d4c957f2dULL
+
+class Sampler {
+    uint64_t state, inc;
+    uint64_t seed;
+
+    // 64 bit mixing function (splitmix64 finalizer)
+    static uint64_t Mix (uint64_t v) {
+        v ^= v >> 31;
+        v *= 0x7fb5d329728ea185ULL;
+        v ^= v >> 27;
+        v *= 0x81dadef4bc2dd44dULL;
+        v ^= v >> 33;
+        return v;
+    }
+public:
+    Sampler (uint64_t _seed=0): seed(_seed) {
+        SetSequence(0);
+    }
+    // selects one of the 2^63 streams
+    void SetSequence (uint64_t sequenceIndex) {
+        state = 0u;
+        inc = (sequenceIndex << 1u) | 1u;
+        UniformUInt32();
+        state += PCG32_DEFAULT_STATE + seed;
+        UniformUInt32();
+    }
+    // skips delta numbers in O(log delta)
+    void Advance (uint64_t delta) {
+        uint64_t curMult = PCG32_MULT, curPlus = inc, accMult = 1u, accPlus = 0u;
+        while (delta > 0) {
+            if (delta & 1) {
+                accMult *= curMult;
+                accPlus = accPlus * curMult + curPlus;
+            }
+            curPlus = (curMult + 1) * curPlus;
+            curMult *= curMult;
+            delta /= 2;
+        }
+        state = accMult * state + accPlus;
+    }
+    // must be called before generating the samples for sample s of pixel (x,y)
+    // each pixel has its own stream, each sample uses up to 65536 numbers of it
+    void StartPixelSample (const int x, const int y, const int s) {
+        SetSequence(Mix(((uint64_t)(uint32_t)x << 32) | (uint32_t)y));
+        Advance((uint64_t)s * 65536u);
+    }
+    uint32_t UniformUInt32 (void) {
+        const uint64_t oldstate = state;
+        state = oldstate * PCG32_MULT + inc;
+        const uint32_t xorshifted = (uint32_t)(((oldstate >> 18u) ^ oldstate) >> 27u);
+        const uint32_t rot = (uint32_t)(oldstate >> 59u);
+        return (xorshifted >> rot) | (xorshifted << ((~rot + 1u) & 31));
+    }
+    // uniform in [0,1[
+    float Get1D (void) {
+        const float OneMinusEpsilon = 0.99999994f;  // largest float < 1
+        const float f = UniformUInt32() * 2.3283064365386963e-10f;  // 2^-32
+        return (f < OneMinusEpsilon ? f : OneMinusEpsilon);
+    }
+    void Get2D (float r[2]) {
+        r[0] = Get1D();
+        r[1] = Get1D();
+    }
+};
+
+#endif /* Sampler_hpp */
@@ -93,12 +93,21 @@ inline std::ostream& operator<<(std::ostream& os, const Group& g) {
 
 struct Model {
     std::vector<Point> vertices;
+    // the vertices before any transformation, and the frame to which the
+    // transformations applied to vertices were evaluated (-1: none)
+    std::vector<Point> rest;
+    int frame;
     double radius;
+    // primitives built from this model (indices on Scene::prims) and, for each,
+    // the indices of its 3 vertices (a sphere uses only the first: its center)
+    // such that they can be updated in place when the model is transformed
+    std::vector<int> prims;
+    std::vector<int> prim_vertices;
 
     Model(std::vector<Point> vertices, double radius) :
-        vertices(vertices), radius(radius) {}
+        vertices(vertices), rest(vertices), frame(-1), radius(radius) {}
     Model(std::vector<Point> vertices) :
-        vertices(vertices), radius(0.0) {}
+        vertices(vertices), rest(vertices), frame(-1), radius(0.0) {}
 };
 
 #endif // COMMON_HPP
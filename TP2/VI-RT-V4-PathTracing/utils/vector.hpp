@@ -95,7 +95,7 @@ public:
     }
     // Generate an orthonormal coordinate system around this vector (must be normalized)
     // returns the 2 new axis orthogonal top the vector
-    void CoordinateSystem(Vector *v2, Vector *v3) {
+    void CoordinateSystem(Vector *v2, Vector *v3) const {
         if (abs(X) > abs(Y))
             *v2 = Vector(-Z, 0, X) / sqrtf(X * X + Z * Z);
         else
@@ -105,7 +105,7 @@ public:
 
     // returns a new vector, which is this vector rotated to the
     // reference system defined by Rx, Ry, Rz
-    Vector Rotate (Vector Rx, Vector Ry, Vector Rz) {
+    Vector Rotate (Vector Rx, Vector Ry, Vector Rz) const {
         Vector vec;
         
         vec.X = X * Rx.X + Y * Ry.X + Z * Rz.X;